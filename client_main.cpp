@@ -4,16 +4,22 @@
 #include <boost/asio.hpp>
 #include <boost/lexical_cast.hpp>
 #include <cstdint>
+#include <deque>
 #include <iostream>
 #include <ndn-cxx/face.hpp>
 #include <ndn-cxx/name.hpp>
 #include <ndn-cxx/interest-filter.hpp>
 #include <ndn-cxx/util/scheduler.hpp>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include "svs.hpp"
+#include "svs_data_server.hpp"
+#include "svs_data_store.hpp"
+#include "svs_fetcher.hpp"
+#include "svs_publisher.hpp"
 
 class Options {
  public:
@@ -22,6 +28,8 @@ class Options {
  public:
   ndn::Name prefix;
   uint64_t m_id;
+  // Keeps published data and sync state across restarts if set
+  std::string storage_path;
 };
 
 namespace ndn {
@@ -30,10 +38,23 @@ namespace svs {
 class Program {
  public:
   explicit Program(const Options &options)
-      : m_options(options),
-        m_scheduler(m_face.getIoService()),
+      : m_scheduler(m_face.getIoService()),
+        // Fetches queue behind sync traffic and share its pacing
+        m_fetcher(m_face, m_scheduler, makeFetcherOptions(),
+                  [this](const Interest &interest, const DataCallback &onData,
+                         const NackCallback &onNack,
+                         const TimeoutCallback &onTimeout) {
+                    m_svs.sendDataInterest(interest, onData, onNack, onTimeout);
+                  }),
+        m_options(options),
         m_svs(m_options.m_id,
-              std::bind(&Program::processSyncUpdate, this, std::placeholders::_1)) {
+              std::bind(&Program::processSyncUpdate, this, std::placeholders::_1),
+              m_face, makeSVSOptions(m_options)),
+        m_data_server(m_svs, m_face, m_keyChain, m_data_store,
+                      makeDataServerOptions()),
+        m_publisher(m_svs, m_face, m_keyChain,
+                    std::bind(&Program::storeData, this, std::placeholders::_1),
+                    makePublisherOptions()) {
     printf("SVS client %llu starts\n", m_options.m_id);
 
     // Suppress warning
@@ -42,24 +63,23 @@ class Program {
 
   void run() {
     m_svs.registerPrefix();
-    // m_face.setInterestFilter(InterestFilter(kSyncDataPrefix),
-    //                       bind(&Program::onDataInterest, this, _2), nullptr);
+    // Serve everything this node holds, not only own data
+    m_data_server.registerPrefix();
 
-    // Create other thread to run
+    // Sync and data fetching share one face and its event loop
     std::thread thread_svs([this] { m_svs.run(); });
 
     std::string init_msg = "User " +
                            boost::lexical_cast<std::string>(m_options.m_id) +
                            " has joined the groupchat";
 
-    m_face.processEvents();
-
     std::string userInput = "";
 
 
     while (true) {
       // send to Sync
       std::getline(std::cin, userInput);
+      if (handleCommand(userInput)) continue;
       publishMsg(userInput);
       std::cout << "\n Message content sent: " << userInput << "/" << std::endl;
       //m_svs.doUpdate();
@@ -74,15 +94,64 @@ class Program {
   Face m_face;
   KeyChain m_keyChain;
   Scheduler m_scheduler;  // Use io_service from face
-  std::unordered_map<Name, std::shared_ptr<const Data>> m_data_store;
-  std::uint16_t seq_no = 1;  //initialize seq number for generating data name, this is current consistent with sync layer seq no. TODO: need to support arbitray data name  
-
-  //Generate Data Name format
-  inline Name GenerateDataName(const NodeID &nid, uint64_t seq) {
-    Name n(kSyncDataPrefix);
-    n.appendNumber(nid).appendNumber(seq).appendNumber(0);
-    std::cout << "generateDataName: " << n << std::endl;
-    return n;
+  Fetcher m_fetcher;
+  DataStore m_data_store;
+  // Own messages included in the next snapshot. Main thread only.
+  std::deque<std::string> m_recent_msgs;
+  uint64_t m_published = 0;
+  static const uint64_t kSnapshotEvery = 100;
+  static const size_t kSnapshotMessages = 20;
+
+  static SVSOptions makeSVSOptions(const Options &options) {
+    SVSOptions svs_options;
+    svs_options.storage_path = options.storage_path;
+    // Keep messages neighbours want even when muted here, so they can be
+    // served from the data store
+    svs_options.relay_for_neighbours = true;
+    return svs_options;
+  }
+
+  static FetcherOptions makeFetcherOptions() {
+    FetcherOptions fetcher_options;
+    // Catching up after a partition takes one round trip per 64 messages
+    fetcher_options.max_range = 64;
+    return fetcher_options;
+  }
+
+  static DataServerOptions makeDataServerOptions() {
+    DataServerOptions server_options;
+    // Lets a holder several hops away answer through this node
+    server_options.forward_probability = 0.5;
+    return server_options;
+  }
+
+  static BatchPublisherOptions makePublisherOptions() {
+    BatchPublisherOptions publisher_options;
+    // Messages typed within one batch window share a packet
+    publisher_options.max_bundle_size = 4000;
+    return publisher_options;
+  }
+
+  /**
+   * handleCommand() - Apply "/sub <id>", "/unsub <id>" or "/all" to the
+   *  subscriptions. Return false if input is a plain message.
+   */
+  bool handleCommand(const std::string &input) {
+    std::istringstream in(input);
+    std::string command;
+    NodeID producer;
+    in >> command;
+    if (command == "/all") {
+      m_svs.subscribeAll();
+    } else if (command == "/sub" && in >> producer) {
+      m_svs.subscribe(producer);
+    } else if (command == "/unsub" && in >> producer) {
+      m_svs.unsubscribe(producer);
+    } else {
+      return false;
+    }
+    std::cout << "Subscriptions updated" << std::endl;
+    return true;
   }
 
   //generate new message, publish data, notify sync layer
@@ -91,46 +160,28 @@ class Program {
     printf(">> %s\n\n", msg.c_str());
     fflush(stdout);
 
-    // Set data name
-    auto n = GenerateDataName(m_options.m_id, ++seq_no);
-    std::shared_ptr<Data> data = std::make_shared<Data>(n);
-
-    // Set data content
-    Buffer contentBuf;
-    for (size_t i = 0; i < msg.length(); ++i)
-      contentBuf.push_back((uint8_t)msg[i]);
-    data->setContent(contentBuf.get<uint8_t>(), contentBuf.size());
-    m_keyChain.sign(
-        *data, security::SigningInfo(security::SigningInfo::SIGNER_TYPE_SHA256));
-    data->setFreshnessPeriod(time::milliseconds(1000));
-
-    m_data_store[n] = data;
-
-    m_svs.doUpdate();
+    // Lines typed in quick succession go out as one batch
+    m_publisher.publish(msg);
+
+    // Every so often, publish the recent conversation as a snapshot, so
+    // nodes joining later need not fetch the whole history
+    m_recent_msgs.push_back(msg);
+    if (m_recent_msgs.size() > kSnapshotMessages) m_recent_msgs.pop_front();
+    if (++m_published % kSnapshotEvery == 0) {
+      std::string snapshot;
+      for (const auto &recent : m_recent_msgs) snapshot += recent + "\n";
+      m_publisher.publishSnapshot(snapshot);
+    }
   }
 
   /**
-   * onDataInterest() -
+   * storeData() - Keep published data for serving; runs on the event loop
+   * like every other data store access
    */
-  void onDataInterest(const Interest &interest) {
-    const auto &n = interest.getName();
-    auto iter = m_data_store.find(n);
-    printf("Received interest: %s\n", n.toUri().c_str());
-
-    // If have data, reply. Otherwise forward with probability
-    if (iter != m_data_store.end()) {
-      std::shared_ptr<Packet> packet;
-      packet->packet_type = Packet::DATA_TYPE;
-      packet->data = iter->second;
-
-      if (n.compare(0, 3, kSyncDataPrefix) == 0) {
-        m_face.put(*packet->data);
-      }
-    }
-    else {
-      assert(0);
-    }
+  void storeData(std::shared_ptr<const Data> data) {
+    m_face.getIoService().post([this, data] { m_data_server.insert(data, true); });
   }
+
   /**
    * onDataReply() - Save data to data store, and call application callback to
    *  pass the data northbound.
@@ -140,17 +191,38 @@ class Program {
     std::cout << "Received data: " << n << std::endl;
     NodeID nid_other = ExtractNodeID(n);
 
+    if (IsSnapshotName(n)) {
+      std::string content((char *)data.getContent().value(),
+                          data.getContent().value_size());
+      printf("Snapshot of %llu up to %llu:\n%s", (unsigned long long)nid_other,
+             (unsigned long long)ExtractSequence(n), content.c_str());
+      m_data_server.insert(data.shared_from_this());
+      return;
+    }
+
     // Drop duplicate data
-    if (m_data_store.find(n) != m_data_store.end()) return;
+    if (m_data_store.contains(nid_other, ExtractSequence(n))) return;
 
     printf("Received data: %s\n", n.toUri().c_str());
-    m_data_store[n] = data.shared_from_this();
-
-    // Pass msg to application in format: <sender_id>:<content>
-    size_t data_size = data.getContent().value_size();
-    std::string content_str((char *)data.getContent().value(), data_size);
-    content_str = boost::lexical_cast<std::string>(nid_other) + ":" + content_str;  
-    printf("Message Received: %s\n", content_str.c_str());
+    m_data_server.insert(data.shared_from_this());
+
+    // Fetched only to serve neighbours subscribed to it
+    if (!m_svs.isSubscribed(nid_other)) return;
+
+    // Pass each msg to application in format: <sender_id>:<content>
+    const auto &content = data.getContent();
+    std::vector<std::string> msgs;
+    if (!IsBundle(data)) {
+      msgs.emplace_back((char *)content.value(), content.value_size());
+    } else if (!DecodeBundle(content.value(), content.value_size(), msgs)) {
+      printf("Malformed bundle: %s\n", n.toUri().c_str());
+      return;
+    }
+    for (const auto &msg : msgs) {
+      std::string content_str =
+          boost::lexical_cast<std::string>(nid_other) + ":" + msg;
+      printf("Message Received: %s\n", content_str.c_str());
+    }
   }
 
   /**
@@ -169,62 +241,46 @@ class Program {
   }
 
   /**
-   * processSyncUpdate() - Receive vector of updates, 
-   * send data interest to fetch missing data
+   * processSyncUpdate() - Receive vector of updates on the event loop and
+   * hand them to the fetcher
    */
-
   void processSyncUpdate(const std::vector<MissingDataInfo>& updates){
     for (const auto& update : updates){
-      for (uint64_t i = update.lowSeq; i <= update.highSeq; i++){
-        //print out updated node id/seq numbers
-        std::cout << "\n Received Sync Update:" << update.nodeID << "/" << i << std::endl;
-        //Send Data Interest to fetch missing data
-        
-        auto n = GenerateDataName(update.nodeID,i); 
-        
-        std::shared_ptr<Packet> packet = std::make_shared<Packet>();
-        packet->packet_type = Packet::INTEREST_TYPE;
-        packet->interest =
-        std::make_shared<Interest>(n, time::milliseconds(1000));
-
-        n = packet->interest->getName();
-
-        std::cout << "InterestName: " << n << std::endl;
-
-        // Data Interest
-        if (n.compare(0, 3, kSyncDataPrefix) == 0) {
-          // Drop falsy data interest
-          if (m_data_store.find(n) != m_data_store.end()) {
-            std::cout << "\n Data Interest name Did not match" << std::endl;
-          }
-
-          m_face.expressInterest(*packet->interest,
-                                 std::bind(&Program::onDataReply, this, _2),
-                                 std::bind(&Program::onNack, this, _1, _2),
-                                 std::bind(&Program::onTimeout, this, _1));
-
-        // pending_data_interest.push_back(std::make_shared<Packet>(packet));
-        }
-      }
+      //print out updated node id/seq numbers
+      std::cout << "\n Received Sync Update:" << update.nodeID << "/"
+                << update.lowSeq << "-" << update.highSeq << std::endl;
     }
-  }  
 
+    m_fetcher.fetchUpdates(updates,
+                           std::bind(&Program::onDataReply, this, _1),
+                           std::bind(&Program::onFetchFailure, this, _1));
+  }
+
+  /**
+   * onFetchFailure() - Print data name given up on by the fetcher.
+   */
+  void onFetchFailure(const Name &n) {
+    std::cout << "Failed to fetch " << n << std::endl;
+  }
 
   const Options m_options;
   SVS m_svs;
+  DataServer m_data_server;
+  BatchPublisher m_publisher;
 };
 
 }  // namespace svs
 }  // namespace ndn
 
 int main(int argc, char **argv) {
-  if (argc != 2) {
-    printf("Usage: TODO\n");
+  if (argc != 2 && argc != 3) {
+    printf("Usage: %s <node-id> [storage-dir]\n", argv[0]);
     exit(1);
   }
 
   Options opt;
   opt.m_id = std::stoll(argv[1]);
+  if (argc == 3) opt.storage_path = argv[2];
 
   ndn::svs::Program program(opt);
   program.run();
@@ -1,6 +1,6 @@
 #include <boost/lexical_cast.hpp>
-#include <chrono>
 #include <iostream>
+#include <ndn-cxx/encoding/block-helpers.hpp>
 #include <ndn-cxx/interest-filter.hpp>
 #include <random>
 
@@ -13,58 +13,390 @@ namespace svs {
  * run() - Start event loop. Called by the application.
  */ 
 void SVS::run() {
-  // Start periodically send sync interest
-  retxSyncInterest();
-
-  // Start periodically send Sync packets asynchronously
-  asyncSendSyncPacket();
+  start();
 
   // Enter event loop
   m_face.processEvents();
 }
 
+/**
+ * start() - Start sync on the calling thread without entering the event
+ *  loop, for callers that drive the face's io_service themselves.
+ */
+void SVS::start() {
+  m_loop_thread.store(std::this_thread::get_id());
+
+  if (m_log) {
+    checkpoint_event = m_scheduler.schedule(m_options.checkpoint_interval,
+                                            [this] { checkpoint(); });
+  }
+
+  // Start periodically send sync interest
+  if (m_options.timer_mode == SyncTimerMode::kTrickle)
+    startTrickleInterval();
+  else
+    retxSyncInterest();
+}
+
 /**
  * registerPrefix() - Called by the constructor.
  */
 void SVS::registerPrefix() {
-  m_face.setInterestFilter(InterestFilter(kSyncNotifyPrefix),
+  m_face.setInterestFilter(InterestFilter(m_options.sync_prefix),
                            bind(&SVS::onSyncInterest, this, _2), nullptr);
 }
 
 /**
- * doUpdate() - Public method called by application when new data is generated,
- * update seq number under current node id in State Vector. 
+ * reserveSeq() - Reserve count consecutive sequence numbers for data about
+ *  to be published, and return the first. Safe to call from any thread.
  */
-void SVS::doUpdate() {
-    m_vv[m_id]++;
-    sendSyncInterest();
+uint64_t SVS::reserveSeq(size_t count) {
+  uint64_t first = m_local_seq.fetch_add(count) + 1;
+  if (m_log) m_log->noteSeq(first + count - 1);
+  return first;
+}
+
+/**
+ * restoreFromLog() - Open the log under SVSOptions::storage_path and resume
+ *  from its state vector checkpoint, past every own seq ever handed out.
+ *  Runs without persistence if the log cannot be opened.
+ */
+void SVS::restoreFromLog() {
+  m_log.reset(new PersistentLog());
+  if (!m_log->open(m_options.storage_path, m_options.storage_max_size)) {
+    std::cerr << "Cannot open log in " << m_options.storage_path
+              << ", running without persistence" << std::endl;
+    m_log.reset();
+    return;
+  }
+
+  VersionVector restored;
+  if (m_log->loadVector(restored)) m_vv = restored;
+  uint64_t own_seq = std::max(m_vv.get(m_id), m_log->getLastSeq());
+  m_vv[m_id] = own_seq;
+  m_local_seq.store(own_seq);
+  ++m_vv_generation;
+
+  if (m_options.sync_mode == SyncMode::kSketch) {
+    for (auto entry : m_vv) m_sketch.update(entry.first, 0, entry.second);
+  }
+  m_metrics.vector_size.set(m_vv.size());
+}
+
+/**
+ * checkpoint() - Save m_vv to the log and schedule the next checkpoint.
+ */
+void SVS::checkpoint() {
+  if (!m_log->saveVector(m_vv))
+    std::cerr << "Failed to checkpoint state vector" << std::endl;
+  checkpoint_event = m_scheduler.schedule(m_options.checkpoint_interval,
+                                          [this] { checkpoint(); });
+}
+
+/**
+ * doUpdate() - Public method called by application when new data up to seq
+ * has been generated, update seq number under current node id in State
+ * Vector. Safe to call from any thread; the update is applied on the event
+ * loop.
+ */
+void SVS::doUpdate(uint64_t seq) {
+  if (onEventLoop()) {
+    applyUpdate(seq);
+    return;
+  }
+
+  Command command;
+  command.type = Command::UPDATE;
+  command.seq = seq;
+  postCommand(std::move(command));
+}
+
+/**
+ * doUpdate() - Reserve the next sequence number and announce it. Return the
+ *  sequence number.
+ */
+uint64_t SVS::doUpdate() {
+  uint64_t seq = reserveSeq();
+  doUpdate(seq);
+  return seq;
+}
+
+/**
+ * applyUpdate() - Raise own entry of the state vector to seq and notify
+ *  neighbours. Updates arriving out of order never lower it.
+ */
+void SVS::applyUpdate(uint64_t seq) {
+  if (seq <= m_vv.get(m_id)) return;
+  if (m_options.sync_mode == SyncMode::kSketch)
+    m_sketch.update(m_id, m_vv.get(m_id), seq);
+  m_vv[m_id] = seq;
+  ++m_vv_generation;
+  if (m_options.sync_mode == SyncMode::kDelta)
+    m_recent_changes.emplace_back(time::steady_clock::now(), m_id);
+  sendSyncInterest();
+  onInconsistency();
+}
+
+void SVS::setSnapshot(uint64_t seq) {
+  if (onEventLoop()) {
+    applySnapshot(m_id, seq);
+    return;
+  }
+
+  Command command;
+  command.type = Command::SNAPSHOT;
+  command.seq = seq;
+  postCommand(std::move(command));
 }
 
 /**
- * asyncSendPacket() - Send one pending Sync packet in transmission queue. Schedule
- *  sending next packet with random delay.
+ * applySnapshot() - Remember that nid has a snapshot covering seq, and
+ *  advertise it from now on. Older boundaries are ignored.
  */
+void SVS::applySnapshot(NodeID nid, uint64_t seq) {
+  uint64_t &boundary = m_snapshots[nid];
+  if (seq <= boundary) return;
+  boundary = seq;
+  // The encoded vector carries the boundaries
+  ++m_vv_generation;
+}
+
+void SVS::subscribe(NodeID producer) {
+  {
+    std::lock_guard<std::mutex> lock(m_interest_mutex);
+    if (m_subscribe_all)
+      m_subscription_exceptions.erase(producer);
+    else
+      m_subscription_exceptions.insert(producer);
+  }
+  onSubscriptionsChanged();
+}
+
+void SVS::unsubscribe(NodeID producer) {
+  {
+    std::lock_guard<std::mutex> lock(m_interest_mutex);
+    if (m_subscribe_all)
+      m_subscription_exceptions.insert(producer);
+    else
+      m_subscription_exceptions.erase(producer);
+  }
+  onSubscriptionsChanged();
+}
+
+void SVS::setSubscriptions(const std::set<NodeID> &producers) {
+  {
+    std::lock_guard<std::mutex> lock(m_interest_mutex);
+    m_subscribe_all = false;
+    m_subscription_exceptions = producers;
+  }
+  onSubscriptionsChanged();
+}
+
+void SVS::subscribeAll() {
+  {
+    std::lock_guard<std::mutex> lock(m_interest_mutex);
+    m_subscribe_all = true;
+    m_subscription_exceptions.clear();
+  }
+  onSubscriptionsChanged();
+}
 
+bool SVS::isSubscribed(NodeID producer) const {
+  if (producer == m_id) return true;
+  std::lock_guard<std::mutex> lock(m_interest_mutex);
+  return m_subscribe_all != (m_subscription_exceptions.count(producer) > 0);
+}
+
+bool SVS::isNeighbourInterested(NodeID producer) const {
+  auto horizon =
+      time::steady_clock::now() - m_options.neighbour_interest_lifetime;
+  std::lock_guard<std::mutex> lock(m_interest_mutex);
+  for (const auto &neighbour : m_neighbour_interest) {
+    if (neighbour.second.last_heard >= horizon &&
+        neighbour.second.producers.count(producer) > 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * onSubscriptionsChanged() - Re-encode the interested bits of the vector on
+ *  the event loop.
+ */
+void SVS::onSubscriptionsChanged() {
+  if (onEventLoop()) {
+    ++m_vv_generation;
+    backfillSubscribed();
+    return;
+  }
+  m_face.getIoService().post([this] {
+    ++m_vv_generation;
+    backfillSubscribed();
+  });
+}
+
+/**
+ * backfillSubscribed() - Queue, for every producer subscribed again, the
+ *  range its vector entry advanced by while it was unsubscribed.
+ */
+void SVS::backfillSubscribed() {
+  if (m_missed.empty()) return;
+  auto subscribed = subscriptionLookup();
+  bool queued = false;
+  for (auto it = m_missed.begin(); it != m_missed.end();) {
+    if (!subscribed(it->first)) {
+      ++it;
+      continue;
+    }
+    MissingDataInfo range;
+    range.nodeID = it->first;
+    range.lowSeq = it->second;
+    range.highSeq = m_vv.get(it->first);
+    it = m_missed.erase(it);
+    if (range.lowSeq > range.highSeq) continue;
+    skipSnapshotHistory(range);
+    pending_updates.push_back(range);
+    queued = true;
+  }
+  if (queued) scheduleSyncUpdates();
+}
+
+/**
+ * noteNeighbourInterest() - Record which producers of vv neighbour is
+ *  interested in. A complete vector replaces what was known about the
+ *  neighbour; a delta updates only the entries it carries.
+ */
+void SVS::noteNeighbourInterest(NodeID neighbour, const VersionVector &vv,
+                                const std::set<NodeID> &interested_nodes,
+                                bool complete) {
+  std::lock_guard<std::mutex> lock(m_interest_mutex);
+  auto horizon =
+      time::steady_clock::now() - m_options.neighbour_interest_lifetime;
+  for (auto it = m_neighbour_interest.begin();
+       it != m_neighbour_interest.end();) {
+    if (it->second.last_heard < horizon)
+      it = m_neighbour_interest.erase(it);
+    else
+      ++it;
+  }
+
+  NeighbourInterest &interest = m_neighbour_interest[neighbour];
+  interest.last_heard = time::steady_clock::now();
+  if (complete) {
+    interest.producers = interested_nodes;
+    return;
+  }
+  for (auto entry : vv) {
+    if (interested_nodes.count(entry.first))
+      interest.producers.insert(entry.first);
+    else
+      interest.producers.erase(entry.first);
+  }
+}
+
+/**
+ * snapshotLookup() - Snapshot boundary by node for the vector encoders, or
+ *  nullptr while none is known.
+ */
+/**
+ * subscriptionLookup() - Return isSubscribed() over a copy of the current
+ *  subscriptions, taking m_interest_mutex once rather than per producer.
+ */
+std::function<bool(NodeID)> SVS::subscriptionLookup() const {
+  std::lock_guard<std::mutex> lock(m_interest_mutex);
+  bool subscribe_all = m_subscribe_all;
+  auto exceptions =
+      std::make_shared<std::set<NodeID>>(m_subscription_exceptions);
+  NodeID id = m_id;
+  return [subscribe_all, exceptions, id](NodeID producer) -> bool {
+    if (producer == id) return true;
+    return subscribe_all != (exceptions->count(producer) > 0);
+  };
+}
+
+std::function<uint64_t(NodeID)> SVS::snapshotLookup() const {
+  if (m_snapshots.empty()) return nullptr;
+  return [this](NodeID nid) -> uint64_t {
+    auto it = m_snapshots.find(nid);
+    return it == m_snapshots.end() ? 0 : it->second;
+  };
+}
+
+/**
+ * onEventLoop() - Whether the caller runs on the thread executing run().
+ */
+bool SVS::onEventLoop() const {
+  return m_loop_thread.load() == std::this_thread::get_id();
+}
+
+/**
+ * postCommand() - Hand command to the event loop. Waits while the command
+ *  queue is full. At most one drain is posted to the io_service at a time.
+ */
+void SVS::postCommand(Command &&command) {
+  while (!m_commands.tryPush(std::move(command))) std::this_thread::yield();
+
+  if (!m_drain_posted.exchange(true))
+    m_face.getIoService().post([this] { drainCommands(); });
+}
+
+/**
+ * drainCommands() - Execute all queued commands on the event loop.
+ */
+void SVS::drainCommands() {
+  // Clear the flag first: commands pushed from now on either get popped
+  // below or post another drain.
+  m_drain_posted.store(false);
+
+  Command command;
+  while (m_commands.tryPop(command)) {
+    switch (command.type) {
+      case Command::UPDATE:
+        applyUpdate(command.seq);
+        break;
+      case Command::SEND_PACKET:
+        m_tx_queue.enqueue(command.tx_class, std::move(command.packet));
+        scheduleTransmit();
+        updateQueueGauges();
+        failDropped();
+        break;
+      case Command::SNAPSHOT:
+        applySnapshot(m_id, command.seq);
+        break;
+    }
+  }
+}
+
+/**
+ * asyncSendSyncPacket() - Send the next packet chosen by the transmit
+ *  scheduler. Reschedule itself only while packets remain.
+ */
 void SVS::asyncSendSyncPacket(){
   Name n;
-  std::shared_ptr<Packet> packet;
-  pending_sync_interest_mutex.lock();
-  if(pending_ack.size()>0){
-    packet = pending_ack.front();
-    pending_ack.pop_front();
-  }else if(pending_sync_interest.size()>0){
-    packet = pending_sync_interest.front();
-    pending_sync_interest.pop_front();
+  PacketPtr packet;
+
+  if (!m_tx_bucket.consume()) {
+    scheduleTransmit();
+    return;
   }
-  pending_sync_interest_mutex.unlock();
+
+  packet = m_tx_queue.dequeue();
 
   if(packet != nullptr){
+    m_metrics.queue_wait.record(time::steady_clock::now() -
+                                packet->enqueue_time);
+    updateQueueGauges();
+
     switch (packet->packet_type){
       case Packet::INTEREST_TYPE:
-      n = packet->interest->getName();
+      n = packet->interest.getName();
 
-      if (n.compare(0, 3, kSyncNotifyPrefix) == 0){
-        m_face.expressInterest(*packet->interest,
+      if (packet->on_data) {
+        m_face.expressInterest(packet->interest, packet->on_data,
+                               packet->on_nack, packet->on_timeout);
+      }else if (m_options.sync_prefix.isPrefixOf(n)){
+        m_metrics.sync_interests_sent.increment();
+        m_face.expressInterest(packet->interest,
                                  std::bind(&SVS::onSyncAck, this, _2),
                                  std::bind(&SVS::onNack, this, _1, _2),
                                  std::bind(&SVS::onTimeout, this, _1));
@@ -76,24 +408,139 @@ void SVS::asyncSendSyncPacket(){
       break;
 
       case Packet::DATA_TYPE:
-      n = packet->data->getName();
-
-      if (n.compare(0, 3, kSyncNotifyPrefix) == 0) {
-        m_face.put(*packet->data);
-      }else{
-        assert(0);
-      }
-
+      m_face.put(packet->getData());
       break;
     
     default:
      assert(0);
     }
   }
-  int delay = packet_dist(rengine_);
-  packet_event.cancel();
-  packet_event = m_scheduler.schedule(time::microseconds(delay),
-                                           [this] { asyncSendSyncPacket(); });
+
+  // Dequeuing drops packets past their deadline
+  failDropped();
+  scheduleTransmit();
+}
+
+/**
+ * scheduleTransmit() - If any packet is queued and no send is pending,
+ *  schedule asyncSendSyncPacket() for when the token bucket allows it.
+ *  Must run on the event loop thread.
+ */
+void SVS::scheduleTransmit() {
+  if (packet_event) return;
+
+  if (m_tx_queue.empty()) return;
+
+  packet_event = m_scheduler.schedule(m_tx_bucket.timeUntilAvailable(),
+                                      [this] { asyncSendSyncPacket(); });
+}
+
+/**
+ * enqueuePacket() - Add packet to the queue of tx_class and wake the sender.
+ *  May be called from any thread; other threads go through the command
+ *  queue.
+ */
+void SVS::enqueuePacket(TxClass tx_class, PacketPtr packet) {
+  packet->enqueue_time = time::steady_clock::now();
+
+  if (onEventLoop()) {
+    if (m_tx_queue.enqueue(tx_class, std::move(packet))) scheduleTransmit();
+    updateQueueGauges();
+    failDropped();
+    return;
+  }
+
+  Command command;
+  command.type = Command::SEND_PACKET;
+  command.tx_class = tx_class;
+  command.packet = std::move(packet);
+  postCommand(std::move(command));
+}
+
+/**
+ * sendDataInterest() - Queue a data interest behind the sync traffic of this
+ *  node. The callbacks run on the SVS event loop.
+ */
+void SVS::sendDataInterest(const Interest &interest, const DataCallback &onData,
+                           const NackCallback &onNack,
+                           const TimeoutCallback &onTimeout) {
+  PacketPtr packet = m_packet_pool.acquire();
+  packet->packet_type = Packet::INTEREST_TYPE;
+  packet->interest = interest;
+  packet->on_data = onData;
+  packet->on_nack = onNack;
+  packet->on_timeout = onTimeout;
+  enqueuePacket(kTxDataInterest, std::move(packet));
+}
+
+void SVS::forwardDataInterest(const Interest &interest,
+                              const DataCallback &onData,
+                              const NackCallback &onNack,
+                              const TimeoutCallback &onTimeout) {
+  PacketPtr packet = m_packet_pool.acquire();
+  packet->packet_type = Packet::INTEREST_TYPE;
+  packet->interest = interest;
+  packet->on_data = onData;
+  packet->on_nack = onNack;
+  packet->on_timeout = onTimeout;
+  enqueuePacket(kTxDataInterestForwarded, std::move(packet));
+}
+
+/**
+ * sendData() - Queue a data reply.
+ */
+void SVS::sendData(std::shared_ptr<const Data> data) {
+  PacketPtr packet = m_packet_pool.acquire();
+  packet->packet_type = Packet::DATA_TYPE;
+  packet->data = std::move(data);
+  enqueuePacket(kTxDataReply, std::move(packet));
+}
+
+/**
+ * getQueueWaitStats() - Return time sent packets spent queued so far.
+ */
+QueueWaitStats SVS::getQueueWaitStats() const {
+  QueueWaitStats stats;
+  stats.packets = m_metrics.queue_wait.getCount();
+  stats.total = m_metrics.queue_wait.getSum();
+  stats.max = m_metrics.queue_wait.getMax();
+  return stats;
+}
+
+/**
+ * updateQueueGauges() - Publish transmit queue depths to the metrics.
+ */
+void SVS::updateQueueGauges() {
+  for (size_t i = 0; i < kTxClassCount; ++i) {
+    m_metrics.queue_depth[i].set(m_tx_queue.size(static_cast<TxClass>(i)));
+    m_metrics.queue_dropped[i].set(
+        m_tx_queue.getDropped(static_cast<TxClass>(i)));
+  }
+}
+
+/**
+ * failDropped() - Time out the data interests the transmit scheduler
+ *  dropped, so their senders retry or give up instead of waiting forever.
+ *  Event loop thread only.
+ */
+void SVS::failDropped() {
+  while (PacketPtr packet = m_tx_queue.takeDropped()) {
+    if (packet->packet_type == Packet::INTEREST_TYPE && packet->on_timeout)
+      packet->on_timeout(packet->interest);
+  }
+}
+
+/**
+ * enableMetricsDump() - Write metrics to target (see DumpMetrics()) every
+ *  period, from a MetricsDumper thread. Replaces any earlier dump. Safe to
+ *  call from any thread.
+ */
+void SVS::enableMetricsDump(const std::string &target,
+                            time::milliseconds period) {
+  m_face.getIoService().post([this, target, period] {
+    m_metrics_dumper.reset();
+    m_metrics_dumper.reset(new MetricsDumper(m_metrics, target, period));
+  });
 }
 
 /**
@@ -114,17 +561,63 @@ void SVS::onSyncInterest(const Interest &interest) {
   bool my_vector_new, other_vector_new;
   VersionVector vv_other;
   std::set<NodeID> interested_nodes;
-  std::tie(vv_other, interested_nodes) =
-      DecodeVVFromNameWithInterest(ExtractEncodedVV(n));
-  std::tie(my_vector_new, other_vector_new) = mergeStateVector(vv_other);
+  SnapshotMap snapshots;
+  const auto &vv_component = ExtractEncodedVVComponent(n);
+  auto origin = time::fromUnixTimestamp(time::milliseconds(n.get(-1).toNumber()));
+  if (IsSketchVV(vv_component.value(), vv_component.value_size())) {
+    if (!reconcileSketch(vv_component.value(), vv_component.value_size(),
+                         origin, my_vector_new, other_vector_new))
+      return;
+  } else if (IsDeltaVV(vv_component.value(), vv_component.value_size())) {
+    uint64_t digest;
+    if (!DecodeDeltaVV(vv_component.value(), vv_component.value_size(),
+                       vv_other, interested_nodes, digest, &snapshots))
+      return;
+    for (const auto &snapshot : snapshots)
+      applySnapshot(snapshot.first, snapshot.second);
+    noteNeighbourInterest(nid_other, vv_other, interested_nodes, false);
+    // A partial vector always looks older than mine. Whether I know more
+    // shows only in the digests after merging; if so, the immediate ACK
+    // below carries my full vector.
+    other_vector_new = mergeStateVector(vv_other, origin).second;
+    my_vector_new = getDigest() != digest;
+  } else {
+    if (!DecodeVV(vv_component.value(), vv_component.value_size(), vv_other,
+                  interested_nodes, &snapshots))
+      return;
+    for (const auto &snapshot : snapshots)
+      applySnapshot(snapshot.first, snapshot.second);
+    noteNeighbourInterest(nid_other, vv_other, interested_nodes, true);
+    std::tie(my_vector_new, other_vector_new) =
+        mergeStateVector(vv_other, origin);
+  }
 
-  // If my vector newer, send ACK immediately. Otherwise send with random delay
+  // If my vector newer, send ACK immediately; it supersedes any delayed ACK
+  // to the same node. Otherwise send with random delay, unless it turns out
+  // redundant by then.
   if (my_vector_new) {
+    auto it = m_pending_acks.find(nid_other);
+    if (it != m_pending_acks.end()) {
+      it->second.event.cancel();
+      m_pending_acks.erase(it);
+      m_metrics.acks_suppressed.increment();
+    }
+    m_metrics.acks_sent_immediate.increment();
     sendSyncACK(n);
   } else {
-    int delay = packet_dist(rengine_);
-    m_scheduler.schedule(time::microseconds(delay),
-                          [this, n] { sendSyncACK(n); });
+    onCoveringVectorHeard();
+    // The name of a batched interest cannot be answered later
+    if (!m_ack_sink) scheduleDelayedAck(nid_other, n);
+  }
+
+  // In Trickle mode an identical vector counts towards suppression and any
+  // difference shrinks the interval
+  if (m_options.timer_mode == SyncTimerMode::kTrickle) {
+    if (!my_vector_new && !other_vector_new)
+      m_trickle.hearConsistent();
+    else
+      onInconsistency();
+    return;
   }
 
   // If incoming state identical to local vector, reset timer to delay sending next sync interest.
@@ -133,6 +626,7 @@ void SVS::onSyncInterest(const Interest &interest) {
   if (!my_vector_new && !other_vector_new) {
     // printf("Delay next sync interest\n");
     fflush(stdout);
+    m_metrics.sync_interests_suppressed.increment();
     retx_event.cancel();
     int delay = retx_dist(rengine_);
     retx_event = m_scheduler.schedule(time::microseconds(delay),
@@ -155,21 +649,33 @@ void SVS::onSyncAck(const Data &data) {
   // Extract content
   VersionVector vv_other;
   std::set<NodeID> interested_nodes;
-  size_t data_size = data.getContent().value_size();
-  std::string content_str((char *)data.getContent().value(), data_size);
-  //printf("Receive Sync ACK: %s\n", content_str.c_str());
-  fflush(stdout);
-  std::tie(vv_other, interested_nodes) =
-      DecodeVVFromNameWithInterest(content_str);
+  SnapshotMap snapshots;
+  const auto &content = data.getContent();
+  if (!DecodeVV(content.value(), content.value_size(), vv_other,
+                interested_nodes, &snapshots))
+    return;
+  for (const auto &snapshot : snapshots)
+    applySnapshot(snapshot.first, snapshot.second);
 
   // Merge state vector
-  mergeStateVector(vv_other);
+  auto result = mergeStateVector(vv_other);
+  if (result.second) onInconsistency();
+  if (!result.first) onCoveringVectorHeard();
+
+  // In delta and sketch mode, a full vector lacking some of my entries
+  // answers a mismatch; complete the exchange with a full sync interest.
+  if (result.first && m_options.sync_mode != SyncMode::kFull &&
+      !m_send_full_vector) {
+    m_send_full_vector = true;
+    sendSyncInterest();
+  }
 }
 
 /**
  * onNack() - Print error msg from NFD.
  */
 void SVS::onNack(const Interest &interest, const lp::Nack &nack) {
+  m_metrics.nacks.increment();
   // std::cout << "received Nack with reason "
   //           << " for interest " << interest << std::endl;
 }
@@ -178,6 +684,7 @@ void SVS::onNack(const Interest &interest, const lp::Nack &nack) {
  * onTimeout() - Print timeout msg.
  */
 void SVS::onTimeout(const Interest &interest) {
+  m_metrics.timeouts.increment();
   //std::cout << "Timeout " << interest << std::endl;
 }
 
@@ -191,132 +698,369 @@ void SVS::retxSyncInterest() {
                                     [this] { retxSyncInterest(); });
 }
 
+/**
+ * startTrickleInterval() - Begin a Trickle interval and schedule its
+ *  transmission point.
+ */
+void SVS::startTrickleInterval() {
+  retx_event = m_scheduler.schedule(m_trickle.beginInterval(rengine_),
+                                    [this] { onTrickleTimer(); });
+}
+
+/**
+ * onTrickleTimer() - Send a sync interest unless enough identical vectors
+ *  were heard this interval, then end the interval with a doubled one.
+ */
+void SVS::onTrickleTimer() {
+  if (m_trickle.shouldTransmit())
+    sendSyncInterest();
+  else
+    m_metrics.sync_interests_suppressed.increment();
+
+  retx_event = m_scheduler.schedule(m_trickle.remaining(), [this] {
+    m_trickle.doubleInterval();
+    startTrickleInterval();
+  });
+}
+
+/**
+ * onInconsistency() - Restart Trickle at the minimum interval. No-op in
+ *  fixed mode, or while the interval already is the minimum.
+ */
+void SVS::onInconsistency() {
+  if (m_options.timer_mode != SyncTimerMode::kTrickle) return;
+  if (!m_trickle.reset()) return;
+  retx_event.cancel();
+  startTrickleInterval();
+}
+
 /**
  * sendSyncInterest() - Add one sync interest to queue. Called by
- *  SVS::retxSyncInterest(), or directly. Because this function is
- *  also called upon new msg via PublishMsg(), the shared data 
- *  structures could cause race conditions.
+ *  SVS::retxSyncInterest(), or upon new data via applyUpdate(). Runs on
+ *  the event loop only.
  */
 void SVS::sendSyncInterest() {
-  using namespace std::chrono;
-
   // Append a timestamp to make name unique
-  std::string encoded_vv = EncodeVVToNameWithInterest(
-      m_vv, [](uint64_t id) -> bool { return true; });
-  milliseconds cur_time_ms =
-      duration_cast<milliseconds>(system_clock::now().time_since_epoch());
-  auto pending_sync_notify =
-      MakeSyncNotifyName(m_id, encoded_vv, cur_time_ms.count());
-
-  // printf("Send sync interest: %s\n", encoded_vv.c_str());
+  auto cur_time_ms = time::toUnixTimestamp(time::system_clock::now());
+  Name pending_sync_notify;
+  if (m_options.sync_mode == SyncMode::kDelta && !m_send_full_vector) {
+    pending_sync_notify =
+        MakeSyncNotifyName(m_options.sync_prefix, m_id, getEncodedDeltaVV(),
+                           cur_time_ms.count());
+  } else if (m_options.sync_mode == SyncMode::kSketch && !m_send_full_vector) {
+    pending_sync_notify =
+        MakeSyncNotifyName(m_options.sync_prefix, m_id, m_sketch.encode(),
+                           cur_time_ms.count());
+  } else {
+    pending_sync_notify =
+        MakeSyncNotifyName(m_options.sync_prefix, m_id, getEncodedVV(),
+                           cur_time_ms.count());
+    m_send_full_vector = false;
+  }
+
+  // printf("Send sync interest: %s\n", getEncodedVV().c_str());
   fflush(stdout);
 
-  // Wrap into Packet
-  Packet packet;
-  packet.packet_type = Packet::INTEREST_TYPE;
-  packet.interest =
-      std::make_shared<Interest>(pending_sync_notify, time::milliseconds(1000));
+  if (m_sync_interest_sink) {
+    m_sync_interest_sink(pending_sync_notify);
+    return;
+  }
+  queueSyncInterest(pending_sync_notify);
+}
 
-  pending_sync_interest_mutex.lock();
-  pending_sync_interest.clear();  // Flush sync interest queue
-  pending_sync_interest.push_back(std::make_shared<Packet>(packet));
-  pending_sync_interest_mutex.unlock();
+/**
+ * queueSyncInterest() - Queue sync interest n for sending.
+ */
+void SVS::queueSyncInterest(const Name &n) {
+  PacketPtr packet = m_packet_pool.acquire();
+  packet->packet_type = Packet::INTEREST_TYPE;
+  packet->interest = Interest(n, time::milliseconds(1000));
+
+  // Replaces any older sync interest still queued
+  enqueuePacket(kTxSyncInterest, std::move(packet));
 }
 
 /**
  * sendSyncACK() - Add an ACK into queue
  */
 void SVS::sendSyncACK(const Name &n) {
-  // Set data name
-  std::shared_ptr<Data> data = std::make_shared<Data>(n);
+  if (m_ack_sink) {
+    getEncodedVV();
+    m_ack_sink(m_ack_content);
+    return;
+  }
+
+  // Built in the packet itself
+  PacketPtr packet = m_packet_pool.acquire();
+  packet->packet_type = Packet::DATA_TYPE;
+  Data &data = packet->local_data;
+  data.setName(n);
 
-  // Set data content
-  std::string encoded_vv = EncodeVVToNameWithInterest(
-      m_vv, [](uint64_t id) -> bool { return true; });
-  Buffer contentBuf;
-  for (size_t i = 0; i < encoded_vv.size(); ++i)
-    contentBuf.push_back((uint8_t)encoded_vv[i]);
-  data->setContent(contentBuf.get<uint8_t>(), contentBuf.size());
-  m_keyChain.sign(
-      *data, security::SigningInfo(security::SigningInfo::SIGNER_TYPE_SHA256));
-  data->setFreshnessPeriod(time::milliseconds(4000));
+  // Set data content. Only name and signature differ between ACKs of the
+  // same vector generation; the signature covers the name.
+  getEncodedVV();
+  data.setContent(m_ack_content);
+  data.setFreshnessPeriod(time::milliseconds(4000));
+  m_keyChain.sign(data, m_ack_signing_info);
 
-  // Wrap into Packet
-  Packet packet;
-  packet.packet_type = Packet::DATA_TYPE;
-  packet.data = data;
+  enqueuePacket(kTxAck, std::move(packet));
+}
+
+/**
+ * scheduleDelayedAck() - Owe requester a delayed ACK for sync interest n.
+ *  A pending one takes over the newer name and keeps its timer. Called right
+ *  after merging a vector of requester that covers the local one.
+ */
+void SVS::scheduleDelayedAck(NodeID requester, const Name &n) {
+  auto it = m_pending_acks.find(requester);
+  if (it != m_pending_acks.end()) {
+    it->second.name = n;
+    it->second.covered_generation = m_vv_generation;
+    m_metrics.acks_suppressed.increment();
+    return;
+  }
+
+  int delay = packet_dist(rengine_);
+  PendingAck &ack = m_pending_acks[requester];
+  ack.name = n;
+  ack.covered_generation = m_vv_generation;
+  ack.event = m_scheduler.schedule(time::microseconds(delay), [this, requester] {
+    onDelayedAck(requester);
+  });
+}
 
-  pending_ack.push_back(std::make_shared<Packet>(packet));
+/**
+ * onDelayedAck() - Send the ACK owed to requester if the local vector moved
+ *  past what requester is known to cover.
+ */
+void SVS::onDelayedAck(NodeID requester) {
+  auto it = m_pending_acks.find(requester);
+  if (it == m_pending_acks.end()) return;
+  PendingAck ack = std::move(it->second);
+  m_pending_acks.erase(it);
+
+  if (ack.covered_generation == m_vv_generation) {
+    m_metrics.acks_suppressed.increment();
+    return;
+  }
+  m_metrics.acks_sent_delayed.increment();
+  sendSyncACK(ack.name);
+}
+
+/**
+ * onCoveringVectorHeard() - A sync interest or ACK carried a vector covering
+ *  the local one. On a shared broadcast medium the nodes we owe ACKs heard it
+ *  as well, so none of those ACKs would tell them anything new.
+ */
+void SVS::onCoveringVectorHeard() {
+  for (auto &entry : m_pending_acks)
+    entry.second.covered_generation = m_vv_generation;
 }
 
 /**
  * mergeStateVector() - Merge state vector, return a pair of boolean
  *  representing: <my_vector_new, other_vector_new>.
- * Then, add missing data interests to data interest queue.
+ * Then, queue the missing data ranges for the application, which fetches
+ *  them. Each merge produces at most one processSyncUpdate call; merges
+ *  within the coalescing window share one.
  */
-std::pair<bool, bool> SVS::mergeStateVector(const VersionVector &vv_other) {
-  bool my_vector_new = false, other_vector_new = false;
+std::pair<bool, bool> SVS::mergeStateVector(
+    const VersionVector &vv_other, time::system_clock::TimePoint origin) {
   //LTX: vector containing a list of missing data info
-  std::vector<MissingDataInfo> updates;
-  std::vector<Name> missingNames;
+  size_t had_pending_size = pending_updates.size();
+  bool had_pending = had_pending_size > 0;
+  auto result = m_vv.merge(vv_other, pending_updates);
+  if (result.second) {
+    ++m_vv_generation;
+    m_metrics.merges_changed_state.increment();
+    m_metrics.vector_size.set(m_vv.size());
+  }
+  if (m_options.sync_mode == SyncMode::kDelta) {
+    auto now = time::steady_clock::now();
+    for (size_t i = had_pending_size; i < pending_updates.size(); ++i)
+      m_recent_changes.emplace_back(now, pending_updates[i].nodeID);
+  } else if (m_options.sync_mode == SyncMode::kSketch) {
+    // Every raised entry produced one range starting right above its old seq
+    for (size_t i = had_pending_size; i < pending_updates.size(); ++i) {
+      const auto &range = pending_updates[i];
+      m_sketch.update(range.nodeID, range.lowSeq - 1, range.highSeq);
+    }
+  }
 
+  // Only subscribed producers reach the application, plus, when relaying,
+  // those a neighbour wants. The vector itself still tracks every producer;
+  // m_missed keeps where the application stopped following each other one.
+  size_t kept = had_pending_size;
+  std::function<bool(NodeID)> subscribed;
+  if (had_pending_size < pending_updates.size())
+    subscribed = subscriptionLookup();
+  for (size_t i = had_pending_size; i < pending_updates.size(); ++i) {
+    auto &range = pending_updates[i];
+    if (!subscribed(range.nodeID)) {
+      m_missed.emplace(range.nodeID, range.lowSeq);
+      if (!m_options.relay_for_neighbours ||
+          !isNeighbourInterested(range.nodeID))
+        continue;
+      range.forRelay = true;
+    }
+    pending_updates[kept++] = range;
+  }
+  pending_updates.resize(kept);
 
-  // Check if other vector has newer state
-  for (auto entry : vv_other) {
-    auto nid_other = entry.first;
-    auto seq_other = entry.second;
-    auto it = m_vv.find(nid_other);
+  if (!m_snapshots.empty()) {
+    for (size_t i = had_pending_size; i < pending_updates.size(); ++i)
+      skipSnapshotHistory(pending_updates[i]);
+  }
+  if (!pending_updates.empty() && origin != time::system_clock::TimePoint() &&
+      (!had_pending || origin < m_pending_update_origin ||
+       m_pending_update_origin == time::system_clock::TimePoint()))
+    m_pending_update_origin = origin;
 
-    if (it == m_vv.end() || it->second < seq_other) {
+  // Neighbours may remember a higher own seq, e.g. from before a restart.
+  // Never hand it out again.
+  uint64_t own_seq = m_vv.get(m_id);
+  uint64_t reserved = m_local_seq.load();
+  while (reserved < own_seq &&
+         !m_local_seq.compare_exchange_weak(reserved, own_seq)) {
+  }
 
-      other_vector_new = true;
+  if (!pending_updates.empty()) scheduleSyncUpdates();
 
-      // Detect new data
-      auto start_seq =
-          m_vv.find(nid_other) == m_vv.end() ? 1 : m_vv[nid_other] + 1;
-      for (auto seq = start_seq; seq <= seq_other; ++seq) {
+  return result;
+}
 
-        auto n = MakeDataName(nid_other,seq);
+/**
+ * skipSnapshotHistory() - Joiners, whose entry was 0 before the range, skip
+ *  history covered by a snapshot. Nodes that merely fell behind fetch the
+ *  full range: a snapshot need not hold every message before its boundary.
+ *  A snapshot reaching highSeq leaves only the snapshot to fetch.
+ */
+void SVS::skipSnapshotHistory(MissingDataInfo &range) const {
+  if (range.lowSeq != 1) return;
+  auto it = m_snapshots.find(range.nodeID);
+  if (it == m_snapshots.end() || it->second > range.highSeq) return;
+  range.snapshotSeq = it->second;
+  range.lowSeq = range.snapshotSeq + 1;
+}
 
-        //add data to missing data queue
-        missingNames.push_back(n);
-        
-        Packet packet;
-        packet.packet_type = Packet::INTEREST_TYPE;
-        packet.interest =
-            std::make_shared<Interest>(n, time::milliseconds(1000));
-        pending_data_interest.push_back(std::make_shared<Packet>(packet));
-      }
-      //LTX: update MissingDataInfo vector
-      updates.push_back(MissingDataInfo{nid_other,start_seq,seq_other});
-      //callback to send updates to application layer
-      processSyncUpdate(updates);
- 
-      // Merge local vector
-      m_vv[nid_other] = seq_other;
+/**
+ * scheduleSyncUpdates() - Deliver pending_updates now, or at the end of the
+ *  coalescing window.
+ */
+void SVS::scheduleSyncUpdates() {
+  if (m_options.update_coalescing_window <= time::milliseconds(0)) {
+    deliverSyncUpdates();
+  } else if (!update_event) {
+    update_event = m_scheduler.schedule(m_options.update_coalescing_window,
+                                        [this] { deliverSyncUpdates(); });
+  }
+}
 
-    }
+/**
+ * getEncodedVV() - Return m_vv encoded in the configured wire format, along
+ *  with the matching ACK content in m_ack_content. Both are rebuilt only
+ *  when m_vv_generation has moved since the last call.
+ */
+const std::string &SVS::getEncodedVV() {
+  if (m_encoded_vv_generation != m_vv_generation || m_encoded_vv.empty()) {
+    m_encoded_vv = EncodeVV(
+        m_vv, subscriptionLookup(), m_options.wire_format, snapshotLookup());
+    m_ack_content = makeBinaryBlock(
+        tlv::Content, reinterpret_cast<const uint8_t *>(m_encoded_vv.data()),
+        m_encoded_vv.size());
+    m_encoded_vv_generation = m_vv_generation;
   }
+  return m_encoded_vv;
+}
 
-  /**
- * deduceMissingData() - Deduce the missing data names, return a vector of data names
- *  representing: <my_vector_new, other_vector_new>.
- * Then, add missing data interests to data interest queue.
+/**
+ * getEncodedDeltaVV() - Return the entries of m_vv changed within the delta
+ *  window and the digest of m_vv, TLV encoded. Drops changes that have
+ *  left the window.
+ */
+std::string SVS::getEncodedDeltaVV() {
+  auto horizon = time::steady_clock::now() - m_options.delta_window;
+  while (!m_recent_changes.empty() &&
+         m_recent_changes.front().first < horizon)
+    m_recent_changes.pop_front();
+
+  VersionVector changed;
+  for (const auto &change : m_recent_changes)
+    changed[change.second] = m_vv.get(change.second);
+  return EncodeDeltaVVToTlv(changed, getDigest(), subscriptionLookup(),
+                            snapshotLookup());
+}
+
+/**
+ * reconcileSketch() - Decode the entries in which a received sketch differs
+ *  from m_sketch and merge those the sender knows newer, so they reach
+ *  processSyncUpdate as usual. Report whether either side knows more; if
+ *  the difference does not decode, count my vector as newer so the
+ *  immediate ACK carries all of it. Return false if buf is malformed.
  */
+bool SVS::reconcileSketch(const uint8_t *buf, size_t size,
+                          time::system_clock::TimePoint origin,
+                          bool &my_vector_new, bool &other_vector_new) {
+  StateSketch diff(m_sketch.cells());
+  if (!StateSketch::decode(buf, size, diff)) return false;
 
-  // Check if I have newer state
-  for (auto entry : m_vv) {
-    auto nid = entry.first;
-    auto seq = entry.second;
-    auto it = vv_other.find(nid);
+  std::vector<std::pair<NodeID, uint64_t>> theirs, mine;
+  if (diff.cells() != m_sketch.cells()) {
+    my_vector_new = true;
+    other_vector_new = false;
+    return true;
+  }
+  diff.subtract(m_sketch);
+  if (!diff.peel(theirs, mine)) {
+    my_vector_new = true;
+    other_vector_new = false;
+    return true;
+  }
 
-    if (it == vv_other.end() || it->second < seq) {
-      my_vector_new = true;
-      break;
-    }
+  VersionVector vv_other;
+  for (const auto &entry : theirs)
+    vv_other[entry.first] = std::max(vv_other.get(entry.first), entry.second);
+
+  my_vector_new = false;
+  for (const auto &entry : mine) {
+    if (entry.second > vv_other.get(entry.first)) my_vector_new = true;
+  }
+  other_vector_new = mergeStateVector(vv_other, origin).second;
+  return true;
+}
+
+/**
+ * getDigest() - Return DigestVV() of m_vv, recomputed only when
+ *  m_vv_generation has moved.
+ */
+uint64_t SVS::getDigest() {
+  if (m_digest_generation != m_vv_generation) {
+    m_digest = DigestVV(m_vv);
+    m_digest_generation = m_vv_generation;
+  }
+  return m_digest;
+}
+
+/**
+ * deliverSyncUpdates() - Pass all pending missing data ranges, merged per
+ *  node, to the application in a single callback.
+ */
+void SVS::deliverSyncUpdates() {
+  update_event = scheduler::EventId();
+  if (pending_updates.empty()) return;
+
+  std::vector<MissingDataInfo> updates;
+  updates.swap(pending_updates);
+  CoalesceMissingDataInfo(updates);
+
+  if (m_pending_update_origin != time::system_clock::TimePoint()) {
+    m_metrics.update_latency.record(time::system_clock::now() -
+                                    m_pending_update_origin);
+    m_pending_update_origin = time::system_clock::TimePoint();
   }
 
-  return std::make_pair(my_vector_new, other_vector_new);
+  //callback to send updates to application layer
+  processSyncUpdate(updates);
 }
 
 }  // namespace svs
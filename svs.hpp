@@ -1,14 +1,22 @@
 #pragma once
 
+#include <atomic>
 #include <deque>
 #include <iostream>
+#include <mutex>
 #include <ndn-cxx/util/scheduler.hpp>
 #include <random>
 #include <thread>
-#include <mutex>
 
 #include "svs_common.hpp"
 #include "svs_helper.hpp"
+#include "svs_log.hpp"
+#include "svs_metrics.hpp"
+#include "svs_mpsc_queue.hpp"
+#include "svs_sketch.hpp"
+#include "svs_token_bucket.hpp"
+#include "svs_trickle_timer.hpp"
+#include "svs_tx_scheduler.hpp"
 
 namespace ndn {
 namespace svs {
@@ -24,24 +32,150 @@ class SVS {
 //     m_vv[id] = 0;
 //   }
 
-  SVS(NodeID id, std::function<void(const std::vector<MissingDataInfo> &)> processSyncUpdate_)
-      : processSyncUpdate(processSyncUpdate_),
-        m_id(id),
-        m_scheduler(m_face.getIoService()),
-        rengine_(rdevice_()) {
-    // Bootstrap with knowledge of itself only
-    m_vv[id] = 0;
-  }
+  SVS(NodeID id, std::function<void(const std::vector<MissingDataInfo> &)> processSyncUpdate_,
+      const SVSOptions &options = SVSOptions())
+      : SVS(id, processSyncUpdate_, nullptr, options) {}
+
+  // Run on a face owned by the caller, e.g. a DummyClientFace
+  SVS(NodeID id, std::function<void(const std::vector<MissingDataInfo> &)> processSyncUpdate_,
+      Face &face, const SVSOptions &options = SVSOptions())
+      : SVS(id, processSyncUpdate_, &face, options) {}
+
+  // Also sign with keyChain, e.g. an in-memory one, instead of building a
+  // default KeyChain from the user's PIB and TPM
+  SVS(NodeID id, std::function<void(const std::vector<MissingDataInfo> &)> processSyncUpdate_,
+      Face &face, KeyChain &keyChain, const SVSOptions &options = SVSOptions())
+      : SVS(id, processSyncUpdate_, &face, nullptr, &keyChain, options) {}
 
   void run();
 
+  void start();
+
+  // Local state vector. Event loop thread only.
+  const VersionVector &getState() const { return m_vv; }
+
+  NodeID getId() const { return m_id; }
+
+  const Name &getSyncPrefix() const { return m_options.sync_prefix; }
+
+  const Name &getDataPrefix() const { return m_options.data_prefix; }
+
   void registerPrefix();
 
   void publishMsg(const std::string &msg);
 
-  void doUpdate();
+  uint64_t reserveSeq(size_t count = 1);
+
+  void doUpdate(uint64_t seq);
+
+  uint64_t doUpdate();
+
+  /**
+   * setSnapshot() - Advertise that the application published a snapshot
+   *  (see MakeSnapshotName()) covering own sequence numbers up to seq. Safe
+   *  to call from any thread.
+   */
+  void setSnapshot(uint64_t seq);
+
+  // Subscriptions decide which producers reach processSyncUpdate and are
+  // advertised as interesting. Every producer is subscribed until
+  // setSubscriptions() or unsubscribe() says otherwise. Subscribing again
+  // delivers the range a producer advanced by while unsubscribed. Safe to
+  // call from any thread.
+  void subscribe(NodeID producer);
+
+  void unsubscribe(NodeID producer);
+
+  void setSubscriptions(const std::set<NodeID> &producers);
+
+  void subscribeAll();
+
+  bool isSubscribed(NodeID producer) const;
+
+  /**
+   * isNeighbourInterested() - Whether a neighbour heard from within
+   *  SVSOptions::neighbour_interest_lifetime advertised interest in
+   *  producer. Safe to call from any thread.
+   */
+  bool isNeighbourInterested(NodeID producer) const;
+
+  QueueWaitStats getQueueWaitStats() const;
+
+  // Readable from any thread
+  const SVSMetrics &getMetrics() const { return m_metrics; }
+
+  void enableMetricsDump(const std::string &target, time::milliseconds period);
+
+  void sendDataInterest(const Interest &interest, const DataCallback &onData,
+                        const NackCallback &onNack,
+                        const TimeoutCallback &onTimeout);
+
+  /**
+   * forwardDataInterest() - Queue a data interest this node could not
+   *  answer, on behalf of a neighbour, behind its own data interests. Sent
+   *  as given: the caller sets a fresh nonce and a bounded HopLimit.
+   */
+  void forwardDataInterest(const Interest &interest, const DataCallback &onData,
+                           const NackCallback &onNack,
+                           const TimeoutCallback &onTimeout);
+
+  void sendData(std::shared_ptr<const Data> data);
+
+  // Log of own published data, or nullptr without SVSOptions::storage_path
+  PersistentLog *getLog() { return m_log.get(); }
 
  private:
+  friend struct SVSTestAccess;
+  friend class SyncGroupManager;
+
+  SVS(NodeID id, std::function<void(const std::vector<MissingDataInfo> &)> processSyncUpdate_,
+      Face *face, const SVSOptions &options)
+      : SVS(id, processSyncUpdate_, face, nullptr, nullptr, options) {}
+
+  // Face, scheduler and KeyChain not given are owned by this instance
+  SVS(NodeID id, std::function<void(const std::vector<MissingDataInfo> &)> processSyncUpdate_,
+      Face *face, Scheduler *scheduler, KeyChain *keyChain,
+      const SVSOptions &options)
+      : processSyncUpdate(processSyncUpdate_),
+        m_id(id),
+        m_options(options),
+        m_owned_face(face ? nullptr : new Face()),
+        m_face(face ? *face : *m_owned_face),
+        m_owned_key_chain(keyChain ? nullptr : new KeyChain()),
+        m_keyChain(keyChain ? *keyChain : *m_owned_key_chain),
+        m_owned_scheduler(scheduler ? nullptr
+                                    : new Scheduler(m_face.getIoService())),
+        m_scheduler(scheduler ? *scheduler : *m_owned_scheduler),
+        m_tx_bucket(options.tx_rate, options.tx_burst),
+        m_tx_queue(options.tx_classes),
+        m_sketch(options.sketch_cells),
+        m_commands(options.command_queue_capacity),
+        m_trickle(options.trickle_interval_min, options.trickle_interval_max,
+                  options.trickle_redundancy),
+        rengine_(options.random_seed ? options.random_seed : rdevice_()) {
+    // Bootstrap with knowledge of itself only
+    m_vv[id] = 0;
+    if (!options.storage_path.empty()) restoreFromLog();
+  }
+
+  // Delayed ACK owed to one requester. Later interests of the same
+  // requester replace name, so it gets at most one.
+  struct PendingAck {
+    Name name;
+    // Generation of m_vv the requester is known to cover. Reaching the
+    // timer with m_vv unchanged since means the ACK would tell nothing new.
+    uint64_t covered_generation;
+    scheduler::EventId event;
+  };
+
+  // Work posted to the event loop by other threads
+  struct Command {
+    enum CommandType { UPDATE, SEND_PACKET, SNAPSHOT } type = UPDATE;
+    uint64_t seq = 0;
+    TxClass tx_class = kTxPacket;
+    PacketPtr packet;
+  };
+
   void asyncSendPacket();
 
   void onSyncInterest(const Interest &interest);
@@ -58,13 +192,79 @@ class SVS {
 
   void retxSyncInterest();
 
+  void startTrickleInterval();
+
+  void onTrickleTimer();
+
+  void onInconsistency();
+
   void sendSyncInterest();
 
+  void queueSyncInterest(const Name &n);
+
   void sendSyncACK(const Name &n);
 
+  void scheduleDelayedAck(NodeID requester, const Name &n);
+
+  void onDelayedAck(NodeID requester);
+
+  void onCoveringVectorHeard();
+
   void asyncSendSyncPacket();
 
-  std::pair<bool, bool> mergeStateVector(const VersionVector &vv_other);
+  void scheduleTransmit();
+
+  void enqueuePacket(TxClass tx_class, PacketPtr packet);
+
+  bool onEventLoop() const;
+
+  void postCommand(Command &&command);
+
+  void drainCommands();
+
+  void applyUpdate(uint64_t seq);
+
+  void applySnapshot(NodeID nid, uint64_t seq);
+
+  void onSubscriptionsChanged();
+
+  void backfillSubscribed();
+
+  std::function<bool(NodeID)> subscriptionLookup() const;
+
+  void skipSnapshotHistory(MissingDataInfo &range) const;
+
+  void scheduleSyncUpdates();
+
+  void noteNeighbourInterest(NodeID neighbour, const VersionVector &vv,
+                             const std::set<NodeID> &interested_nodes,
+                             bool complete);
+
+  std::function<uint64_t(NodeID)> snapshotLookup() const;
+
+  void restoreFromLog();
+
+  void checkpoint();
+
+  void updateQueueGauges();
+
+  void failDropped();
+
+  std::pair<bool, bool> mergeStateVector(
+      const VersionVector &vv_other,
+      time::system_clock::TimePoint origin = time::system_clock::TimePoint());
+
+  void deliverSyncUpdates();
+
+  const std::string &getEncodedVV();
+
+  std::string getEncodedDeltaVV();
+
+  uint64_t getDigest();
+
+  bool reconcileSketch(const uint8_t *buf, size_t size,
+                       time::system_clock::TimePoint origin,
+                       bool &my_vector_new, bool &other_vector_new);
 
 //   std::function<void(const std::string &)> onMsg;
 
@@ -72,22 +272,60 @@ class SVS {
 
   // Members
   NodeID m_id;
-  Face m_face;
-  KeyChain m_keyChain;
+  const SVSOptions m_options;
+  std::unique_ptr<Face> m_owned_face;
+  Face &m_face;
+  std::unique_ptr<KeyChain> m_owned_key_chain;
+  KeyChain &m_keyChain;
   VersionVector m_vv;
-  Scheduler m_scheduler;  // Use io_service from face
-  std::unordered_map<Name, std::shared_ptr<const Data>> m_data_store;
-
-  // Mult-level queues
-  std::deque<std::shared_ptr<Packet>> pending_packet;
-  std::deque<std::shared_ptr<Packet>> pending_ack;
-  std::deque<std::shared_ptr<Packet>> pending_sync_interest;
-  std::deque<std::shared_ptr<Packet>> pending_data_reply;
-  std::deque<std::shared_ptr<Packet>> pending_data_interest_forwarded;
-  std::deque<std::shared_ptr<Packet>> pending_data_interest;
-  std::mutex pending_sync_interest_mutex;
-
-  // Microseconds between sending two packets in the queues
+  // Bumped whenever m_vv changes, invalidating the encodings below
+  uint64_t m_vv_generation = 0;
+  uint64_t m_encoded_vv_generation = 0;
+  std::string m_encoded_vv;
+  Block m_ack_content;
+  uint64_t m_digest_generation = 0;
+  uint64_t m_digest = 0;
+  // Entries changed recently, oldest first, for delta sync interests. May
+  // hold a node more than once.
+  std::deque<std::pair<time::steady_clock::TimePoint, NodeID>> m_recent_changes;
+  // The next sync interest carries the full vector, because a neighbour
+  // was found missing entries that may have left the delta window
+  bool m_send_full_vector = false;
+  const security::SigningInfo m_ack_signing_info =
+      security::SigningInfo(security::SigningInfo::SIGNER_TYPE_SHA256);
+  std::unique_ptr<Scheduler> m_owned_scheduler;
+  Scheduler &m_scheduler;  // Use io_service from face
+  TokenBucket m_tx_bucket;  // Paces asyncSendSyncPacket()
+
+  // Every queued packet comes from here; outlives m_tx_queue and m_commands
+  PacketPool m_packet_pool;
+
+  // Mult-level queues, one per TxClass. Event loop thread only.
+  TxScheduler m_tx_queue;
+
+  // Sketch of m_vv, kept up to date in SyncMode::kSketch
+  StateSketch m_sketch;
+
+  // Cross-thread command channel into the event loop
+  MpscQueue<Command> m_commands;
+  std::atomic<bool> m_drain_posted{false};
+  std::atomic<std::thread::id> m_loop_thread{std::thread::id()};
+  // Highest sequence number handed out by reserveSeq()
+  std::atomic<uint64_t> m_local_seq{0};
+
+  // Sync interest timing in SyncTimerMode::kTrickle
+  TrickleTimer m_trickle;
+
+  std::unique_ptr<PersistentLog> m_log;
+
+  SVSMetrics m_metrics;
+  // Dumps m_metrics off the event loop, see enableMetricsDump()
+  std::unique_ptr<MetricsDumper> m_metrics_dumper;
+  // Send time of the oldest sync interest whose updates wait in
+  // pending_updates, for the update_latency histogram
+  time::system_clock::TimePoint m_pending_update_origin;
+
+  // Microseconds for delaying an ACK of a vector that is not newer
   std::uniform_int_distribution<> packet_dist =
       std::uniform_int_distribution<>(10000, 15000);
   // Microseconds between sending two sync interests
@@ -100,9 +338,44 @@ class SVS {
   std::random_device rdevice_;
   std::mt19937 rengine_;
 
+  struct NeighbourInterest {
+    std::set<NodeID> producers;
+    time::steady_clock::TimePoint last_heard;
+  };
+
+  // Subscriptions: with m_subscribe_all, the producers in
+  // m_subscription_exceptions are unsubscribed; otherwise only they are
+  // subscribed. Guarded by m_interest_mutex, like m_neighbour_interest.
+  mutable std::mutex m_interest_mutex;
+  bool m_subscribe_all = true;
+  std::set<NodeID> m_subscription_exceptions;
+  std::unordered_map<NodeID, NeighbourInterest> m_neighbour_interest;
+
+  // Latest snapshot boundary known per producer, own one included
+  SnapshotMap m_snapshots;
+
+  // Lowest seq of each producer whose range was not delivered to the
+  // application as subscribed; handed out when it is subscribed again
+  std::unordered_map<NodeID, uint64_t> m_missed;
+
+  // Set by SyncGroupManager. The first takes over every sync interest
+  // built; the second, while set, receives the content of immediate ACKs
+  // instead of them being sent, and suppresses delayed ACKs.
+  std::function<void(const Name &)> m_sync_interest_sink;
+  std::function<void(const Block &)> m_ack_sink;
+
+  // Delayed ACKs by requester
+  std::unordered_map<NodeID, PendingAck> m_pending_acks;
+
+  // Missing data ranges waiting for the coalescing window to close
+  std::vector<MissingDataInfo> pending_updates;
+
   // Events
-  scheduler::EventId retx_event;    // will send retx next sync intrest
-  scheduler::EventId packet_event;  // Will send next packet async
+  scheduler::EventId retx_event;    // will send retx next sync intrest, or
+                                    // fire the next Trickle event
+  scheduler::EventId packet_event;  // Will send next queued packet
+  scheduler::EventId update_event;  // Will deliver pending_updates
+  scheduler::EventId checkpoint_event;  // Will checkpoint m_vv to m_log
 };
 
 }  // namespace svs
@@ -0,0 +1,398 @@
+// Microbenchmarks for the sync hot paths. Build and run with `make bench`;
+// results are printed as a JSON array (or written to the file given with
+// --out) so runs can be compared across releases.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <ndn-cxx/util/dummy-client-face.hpp>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "svs.hpp"
+#include "svs_publisher.hpp"
+#include "svs_test_access.hpp"
+
+// Heap allocations of the process, for allocs_per_op. operator new[] and
+// the sized deletes forward to these.
+static std::atomic<uint64_t> g_allocations{0};
+
+void *operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+namespace ndn {
+namespace svs {
+
+using MapVersionVector = std::unordered_map<NodeID, uint64_t>;
+
+/**
+ * BenchReporter - Collects results and prints them as a JSON array of
+ *  {"name", "params", "ns_per_op", "allocs_per_op", "iterations"} objects.
+ */
+class BenchReporter {
+ public:
+  void add(const std::string &name, const std::string &params,
+           double ns_per_op, double allocs_per_op, size_t iterations) {
+    std::ostringstream os;
+    os << "  {\"name\": \"" << name << "\", \"params\": {" << params
+       << "}, \"ns_per_op\": " << ns_per_op
+       << ", \"allocs_per_op\": " << allocs_per_op
+       << ", \"iterations\": " << iterations << "}";
+    m_results.push_back(os.str());
+    std::cerr << name << " {" << params << "}: " << ns_per_op << " ns/op, "
+              << allocs_per_op << " allocs/op" << std::endl;
+  }
+
+  void print(std::ostream &os) const {
+    os << "[\n";
+    for (size_t i = 0; i < m_results.size(); ++i)
+      os << m_results[i] << (i + 1 < m_results.size() ? ",\n" : "\n");
+    os << "]\n";
+  }
+
+ private:
+  std::vector<std::string> m_results;
+};
+
+/**
+ * Measure() - Run fn in growing batches until one batch takes at least
+ *  100 ms, and report the per-call time and heap allocations of that batch.
+ */
+template <typename Fn>
+static void Measure(BenchReporter &reporter, const std::string &name,
+                    const std::string &params, Fn &&fn) {
+  using clock = std::chrono::steady_clock;
+  for (size_t iterations = 1;; iterations *= 2) {
+    uint64_t allocations = g_allocations.load(std::memory_order_relaxed);
+    auto start = clock::now();
+    for (size_t i = 0; i < iterations; ++i) fn();
+    auto elapsed = clock::now() - start;
+    allocations = g_allocations.load(std::memory_order_relaxed) - allocations;
+    if (elapsed >= std::chrono::milliseconds(100) ||
+        iterations >= (1u << 30)) {
+      reporter.add(name, params,
+                   std::chrono::duration<double, std::nano>(elapsed).count() /
+                       iterations,
+                   static_cast<double>(allocations) / iterations, iterations);
+      return;
+    }
+  }
+}
+
+static std::string Params(size_t size, double ratio = -1) {
+  std::ostringstream os;
+  os << "\"size\": " << size;
+  if (ratio >= 0) os << ", \"overlap\": " << ratio;
+  return os.str();
+}
+
+/**
+ * MakeVectors() - Build two vectors of the given size where the overlap
+ *  fraction of the entries of other are identical to mine and the rest are
+ *  newer.
+ */
+static void MakeVectors(size_t size, double overlap, std::mt19937 &rng,
+                        VersionVector &mine, VersionVector &other) {
+  std::bernoulli_distribution same(overlap);
+  mine.clear();
+  other.clear();
+  for (size_t i = 0; i < size; ++i) {
+    NodeID nid = i * 7 + 1;
+    uint64_t seq = 100 + i;
+    mine[nid] = seq;
+    other[nid] = same(rng) ? seq : seq + 3;
+  }
+}
+
+/**
+ * MapMerge() - Reference merge over a hash map, as SVS::mergeStateVector did
+ *  before VersionVector became a sorted flat array.
+ */
+static std::pair<bool, bool> MapMerge(MapVersionVector &mine,
+                                      const MapVersionVector &other,
+                                      std::vector<MissingDataInfo> &missing) {
+  bool my_vector_new = false, other_vector_new = false;
+  for (auto entry : other) {
+    auto it = mine.find(entry.first);
+    if (it == mine.end() || it->second < entry.second) {
+      other_vector_new = true;
+      auto start_seq =
+          mine.find(entry.first) == mine.end() ? 1 : mine[entry.first] + 1;
+      missing.push_back(MissingDataInfo{entry.first, start_seq, entry.second});
+      mine[entry.first] = entry.second;
+    }
+  }
+  for (auto entry : mine) {
+    auto it = other.find(entry.first);
+    if (it == other.end() || it->second < entry.second) {
+      my_vector_new = true;
+      break;
+    }
+  }
+  return std::make_pair(my_vector_new, other_vector_new);
+}
+
+/**
+ * SVSBench - Drives private SVS hot paths, through SVSTestAccess, on an
+ *  SVS bound to a DummyClientFace, so no forwarder is needed.
+ */
+class SVSBench {
+ public:
+  SVSBench()
+      : m_keyChain("pib-memory:", "tpm-memory:"),
+        m_face(m_io, m_keyChain, util::DummyClientFace::Options(false, false)),
+        m_svs(1, [](const std::vector<MissingDataInfo> &) {}, m_face,
+              m_keyChain) {
+    // Makes this thread the SVS event loop, so sends are queued directly
+    m_svs.start();
+  }
+
+  void run(BenchReporter &reporter) {
+    std::mt19937 rng(42);
+    const std::vector<size_t> sizes = {1, 10, 100, 1000, 10000};
+
+    for (size_t size : sizes) {
+      VersionVector vv, other;
+      MakeVectors(size, 1.0, rng, vv, other);
+      auto all = [](uint64_t) { return true; };
+
+      std::string tlv = EncodeVVToTlv(vv, all);
+      std::string str = EncodeVVToNameWithInterest(vv, all);
+      Measure(reporter, "encode_vv_tlv", Params(size),
+              [&] { tlv = EncodeVVToTlv(vv, all); });
+      Measure(reporter, "encode_vv_string", Params(size),
+              [&] { str = EncodeVVToNameWithInterest(vv, all); });
+      Measure(reporter, "decode_vv_tlv", Params(size), [&] {
+        VersionVector out;
+        std::set<NodeID> interested;
+        DecodeVV(reinterpret_cast<const uint8_t *>(tlv.data()), tlv.size(), out,
+                 interested);
+      });
+      Measure(reporter, "decode_vv_tlv_visit", Params(size), [&] {
+        uint64_t sum = 0;
+        DecodeVVTlv(reinterpret_cast<const uint8_t *>(tlv.data()), tlv.size(),
+                    [&](NodeID nid, uint64_t seq, bool) { sum += seq; });
+        m_sink += sum;
+      });
+      Measure(reporter, "decode_vv_string", Params(size), [&] {
+        VersionVector out;
+        std::set<NodeID> interested;
+        DecodeVV(reinterpret_cast<const uint8_t *>(str.data()), str.size(), out,
+                 interested);
+      });
+    }
+
+    for (size_t size : sizes) {
+      for (double overlap : {0.0, 0.5, 0.9, 1.0}) {
+        VersionVector base, other;
+        MakeVectors(size, overlap, rng, base, other);
+        MapVersionVector map_base(base.begin(), base.end());
+        MapVersionVector map_other(other.begin(), other.end());
+        MapVersionVector map_copy;
+        VersionVector flat_copy;
+        std::vector<MissingDataInfo> missing;
+
+        // Each iteration restores the local vector first; merge_restore_*
+        // reports that share.
+        Measure(reporter, "merge_map", Params(size, overlap), [&] {
+          map_copy = map_base;
+          missing.clear();
+          MapMerge(map_copy, map_other, missing);
+        });
+        Measure(reporter, "merge_restore_map", Params(size, overlap),
+                [&] { map_copy = map_base; });
+        Measure(reporter, "merge_flat", Params(size, overlap), [&] {
+          flat_copy = base;
+          missing.clear();
+          flat_copy.merge(other, missing);
+        });
+        Measure(reporter, "merge_restore_flat", Params(size, overlap),
+                [&] { flat_copy = base; });
+        Measure(reporter, "merge_state_vector", Params(size, overlap), [&] {
+          SVSTestAccess::state(m_svs) = base;
+          SVSTestAccess::mergeStateVector(m_svs, other);
+        });
+      }
+    }
+
+    // Full-vector versus sketch reconciliation of two vectors differing in
+    // a few entries, from encoding on the sender to merging on the receiver
+    for (size_t size : {100, 1000, 10000}) {
+      for (size_t changed : {1, 10}) {
+        VersionVector base, other;
+        MakeVectors(size, 1.0, rng, base, other);
+        for (size_t i = 0; i < changed; ++i)
+          other[other.ids()[rng() % size]] += 1 + rng() % 3;
+        StateSketch base_sketch(60), other_sketch(60);
+        for (auto entry : base) base_sketch.insert(entry.first, entry.second);
+        for (auto entry : other) other_sketch.insert(entry.first, entry.second);
+        auto all = [](uint64_t) { return true; };
+        VersionVector copy;
+        std::vector<MissingDataInfo> missing;
+
+        std::ostringstream full_params, sketch_params;
+        full_params << Params(size) << ", \"changed\": " << changed
+                    << ", \"bytes\": " << EncodeVVToTlv(other, all).size();
+        sketch_params << Params(size) << ", \"changed\": " << changed
+                      << ", \"bytes\": " << other_sketch.encode().size();
+
+        Measure(reporter, "reconcile_full", full_params.str(), [&] {
+          std::string wire = EncodeVVToTlv(other, all);
+          VersionVector received;
+          std::set<NodeID> interested;
+          DecodeVV(reinterpret_cast<const uint8_t *>(wire.data()), wire.size(),
+                   received, interested);
+          copy = base;
+          missing.clear();
+          copy.merge(received, missing);
+        });
+        Measure(reporter, "reconcile_sketch", sketch_params.str(), [&] {
+          std::string wire = other_sketch.encode();
+          StateSketch diff(60);
+          StateSketch::decode(reinterpret_cast<const uint8_t *>(wire.data()),
+                              wire.size(), diff);
+          diff.subtract(base_sketch);
+          std::vector<std::pair<NodeID, uint64_t>> theirs, mine;
+          diff.peel(theirs, mine);
+          VersionVector received;
+          for (const auto &entry : theirs) received[entry.first] = entry.second;
+          copy = base;
+          missing.clear();
+          copy.merge(received, missing);
+        });
+      }
+    }
+
+    for (size_t size : {10, 1000}) {
+      VersionVector vv, other;
+      MakeVectors(size, 1.0, rng, vv, other);
+      std::string encoded = EncodeVVToTlv(vv, [](uint64_t) { return true; });
+      Measure(reporter, "make_sync_notify_name", Params(size), [&] {
+        Name n = MakeSyncNotifyName(1, encoded, 1600000000000);
+        m_sink += n.size();
+      });
+    }
+    Measure(reporter, "make_data_name", "", [&] {
+      Name n = MakeDataName(12345, 678);
+      m_sink += n.size();
+    });
+
+    // Publishing a batch of small messages one Data each versus bundled;
+    // "packets" is the number of Data signed per batch
+    for (size_t bundle_size : {0, 4000}) {
+      size_t packets = 0;
+      BatchPublisherOptions publisher_options;
+      publisher_options.max_bundle_size = bundle_size;
+      BatchPublisher publisher(
+          m_svs, m_face, m_keyChain,
+          [&](std::shared_ptr<const Data>) { ++packets; }, publisher_options);
+      std::vector<std::string> batch(64, std::string(32, 'm'));
+      publisher.publishBatch(batch);
+
+      std::ostringstream params;
+      params << "\"messages\": " << batch.size()
+             << ", \"bundle_size\": " << bundle_size
+             << ", \"packets\": " << packets;
+      Measure(reporter, "publish_batch", params.str(),
+              [&] { publisher.publishBatch(batch); });
+    }
+
+    for (size_t size : {10, 100, 1000}) {
+      VersionVector other;
+      MakeVectors(size, 1.0, rng, SVSTestAccess::state(m_svs), other);
+      SVSTestAccess::touchState(m_svs);
+      Name interest_name = MakeSyncNotifyName(
+          2, SVSTestAccess::getEncodedVV(m_svs), 1600000000000);
+
+      Measure(reporter, "send_sync_ack_cached", Params(size),
+              [&] { SVSTestAccess::sendSyncACK(m_svs, interest_name); });
+      Measure(reporter, "send_sync_ack_reencode", Params(size), [&] {
+        SVSTestAccess::touchState(m_svs);
+        SVSTestAccess::sendSyncACK(m_svs, interest_name);
+      });
+    }
+
+    // Queue round trips through the transmit scheduler, without the face;
+    // allocs_per_op shows what the packet pool leaves to the heap. Each
+    // starts from empty queues, so packets left over by the benchmarks
+    // above neither take the dequeues nor count as drops.
+    {
+      Name interest_name = MakeSyncNotifyName(
+          2, SVSTestAccess::getEncodedVV(m_svs), 1600000000000);
+      auto reply = std::make_shared<Data>(MakeDataName(2, 1));
+      m_keyChain.sign(*reply, security::SigningInfo(
+                                   security::SigningInfo::SIGNER_TYPE_SHA256));
+
+      drainTxQueue();
+      Measure(reporter, "tx_sync_interest", "", [&] {
+        SVSTestAccess::queueSyncInterest(m_svs, interest_name);
+        m_sink += SVSTestAccess::txQueue(m_svs).dequeue() != nullptr;
+      });
+      drainTxQueue();
+      Measure(reporter, "tx_sync_ack", "", [&] {
+        SVSTestAccess::sendSyncACK(m_svs, interest_name);
+        m_sink += SVSTestAccess::txQueue(m_svs).dequeue() != nullptr;
+      });
+      drainTxQueue();
+      Measure(reporter, "tx_data_reply", "", [&] {
+        m_svs.sendData(reply);
+        m_sink += SVSTestAccess::txQueue(m_svs).dequeue() != nullptr;
+      });
+    }
+  }
+
+ private:
+  void drainTxQueue() {
+    while (SVSTestAccess::txQueue(m_svs).dequeue()) {
+    }
+    while (SVSTestAccess::txQueue(m_svs).takeDropped()) {
+    }
+  }
+
+  boost::asio::io_service m_io;
+  KeyChain m_keyChain;
+  util::DummyClientFace m_face;
+  SVS m_svs;
+  uint64_t m_sink = 0;
+};
+
+}  // namespace svs
+}  // namespace ndn
+
+int main(int argc, char **argv) {
+  std::string out_path;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--out" && i + 1 < argc) {
+      out_path = argv[++i];
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--out results.json]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  ndn::svs::BenchReporter reporter;
+  ndn::svs::SVSBench bench;
+  bench.run(reporter);
+
+  if (out_path.empty()) {
+    reporter.print(std::cout);
+  } else {
+    std::ofstream out(out_path);
+    reporter.print(out);
+  }
+  return 0;
+}
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <ndn-cxx/face.hpp>
 #include <ndn-cxx/name.hpp>
 #include <set>
+#include <string>
 #include <unordered_map>
 
 namespace ndn {
@@ -11,25 +13,169 @@ namespace svs {
 
 // Type and constant declarations for State Vector Sync (SVS)
 using NodeID = uint64_t;
-using VersionVector = std::unordered_map<NodeID, uint64_t>;
 
 static const Name kSyncNotifyPrefix = Name("/ndn/svs/syncNotify");
 static const Name kSyncDataPrefix = Name("/ndn/svs/vsyncData");
 
+// Wire format of the state vector carried in sync interest names and ACKs.
+// Decoders accept both, so kString is only needed while legacy nodes remain
+// in the group.
+enum class VVWireFormat { kString, kTlv };
+
+// How the periodic sync interest is timed. kFixed sends one every 0.9-1.1 s
+// and postpones it on hearing an identical vector; kTrickle adapts the
+// period with the Trickle algorithm (RFC 6206).
+enum class SyncTimerMode { kFixed, kTrickle };
+
+// What sync interests carry. kFull sends the whole state vector. kDelta
+// sends the entries changed within SVSOptions::delta_window plus a digest of
+// the whole vector. kSketch sends a fixed-size invertible Bloom filter of the
+// vector, from which receivers decode the entries that differ. Both fall
+// back to a full exchange when they cannot tell the difference, and are
+// always TLV encoded.
+enum class SyncMode { kFull, kDelta, kSketch };
+
+// Traffic classes of the transmit scheduler, served by deficit round robin
+// in this order
+enum TxClass {
+  kTxAck,
+  kTxSyncInterest,
+  kTxDataReply,
+  kTxDataInterestForwarded,
+  kTxDataInterest,
+  kTxPacket,
+  kTxClassCount
+};
+
+// What to do with a packet arriving at a full class queue
+enum class DropPolicy {
+  kDropTail,    // Drop the arriving packet
+  kDropHead,    // Drop the oldest queued packet
+  kKeepNewest,  // Replace everything queued with the arriving packet
+};
+
+struct TxClassConfig {
+  // Bytes credited to the class per round
+  uint32_t quantum;
+  size_t max_packets;
+  // Queued packets older than this are dropped. Zero disables the deadline.
+  time::milliseconds deadline;
+  DropPolicy drop_policy;
+};
+
+inline std::array<TxClassConfig, kTxClassCount> DefaultTxClassConfig() {
+  using ms = time::milliseconds;
+  std::array<TxClassConfig, kTxClassCount> config;
+  config[kTxAck] = {1500, 64, ms(1000), DropPolicy::kDropHead};
+  config[kTxSyncInterest] = {1500, 1, ms(1000), DropPolicy::kKeepNewest};
+  config[kTxDataReply] = {3000, 256, ms(2000), DropPolicy::kDropTail};
+  config[kTxDataInterestForwarded] = {1500, 128, ms(1000), DropPolicy::kDropHead};
+  config[kTxDataInterest] = {1500, 256, ms(1000), DropPolicy::kDropTail};
+  config[kTxPacket] = {1500, 256, ms(0), DropPolicy::kDropTail};
+  return config;
+}
+
+// Construction-time configuration of an SVS instance
+struct SVSOptions {
+  // Names of the sync group: sync interests go under sync_prefix, data
+  // under data_prefix
+  Name sync_prefix = kSyncNotifyPrefix;
+  Name data_prefix = kSyncDataPrefix;
+  VVWireFormat wire_format = VVWireFormat::kTlv;
+  // Updates from merges within this window are delivered in one
+  // processSyncUpdate call. Zero delivers every merge immediately.
+  time::milliseconds update_coalescing_window = time::milliseconds(0);
+  // Pacing of sync packets: average packets per second and burst size.
+  // A rate of zero sends packets as soon as they are queued.
+  double tx_rate = 80;
+  double tx_burst = 4;
+  std::array<TxClassConfig, kTxClassCount> tx_classes = DefaultTxClassConfig();
+  // Slots of the queue carrying publishes and sends from other threads into
+  // the SVS event loop. Producers wait while it is full.
+  size_t command_queue_capacity = 1024;
+  SyncMode sync_mode = SyncMode::kFull;
+  // How long a changed entry stays in delta sync interests. Spanning a few
+  // sync interest periods lets a single lost interest go unnoticed.
+  time::milliseconds delta_window = time::milliseconds(3000);
+  // Cells of the kSketch filter, rounded up to a multiple of three. A
+  // sketch decodes up to about two thirds as many differing entries, a
+  // changed seq counting twice. Every node of a group must use the same.
+  size_t sketch_cells = 60;
+  SyncTimerMode timer_mode = SyncTimerMode::kFixed;
+  // Trickle interval bounds. The interval doubles while the group is
+  // consistent and drops back to the minimum on any difference.
+  time::milliseconds trickle_interval_min = time::milliseconds(100);
+  time::milliseconds trickle_interval_max = time::milliseconds(30000);
+  // Trickle redundancy constant k: skip a sync interest after hearing k
+  // identical vectors in the same interval. Zero never skips.
+  uint32_t trickle_redundancy = 2;
+  // Also report producers this node is not subscribed to while a neighbour
+  // heard within neighbour_interest_lifetime is (MissingDataInfo::forRelay)
+  bool relay_for_neighbours = false;
+  time::milliseconds neighbour_interest_lifetime = time::milliseconds(10000);
+  // Directory of the PersistentLog keeping own published data, the highest
+  // own seq and a state vector checkpoint across restarts. Empty keeps
+  // everything in memory.
+  std::string storage_path;
+  // Largest the data log may grow; also the address space it maps up front.
+  // A log already larger than this does not open.
+  size_t storage_max_size = size_t(64) << 20;
+  time::milliseconds checkpoint_interval = time::milliseconds(5000);
+  // Seed of the timer jitter. Zero seeds from std::random_device.
+  uint32_t random_seed = 0;
+};
+
+// Time packets spent in the transmit queues before being sent
+struct QueueWaitStats {
+  uint64_t packets = 0;
+  time::nanoseconds total = time::nanoseconds(0);
+  time::nanoseconds max = time::nanoseconds(0);
+};
+
 //structure for encoding missing data info, e.g. /A/4-7
 struct MissingDataInfo
 {
   ndn::svs::NodeID nodeID;
   uint64_t lowSeq;
   uint64_t highSeq;
+  // If non-zero, fetch the producer's snapshot covering sequence numbers up
+  // to this one (see MakeSnapshotName()) instead of enumerating them;
+  // lowSeq then starts right after it, past highSeq if the snapshot covers
+  // the whole range. Set only for producers first heard; if the snapshot
+  // cannot be fetched, 1..snapshotSeq must be fetched by name.
+  uint64_t snapshotSeq = 0;
+  // Set for producers this node is not subscribed to but a neighbour is,
+  // with SVSOptions::relay_for_neighbours: fetch to keep and serve only
+  bool forRelay = false;
 };
 
+// Latest snapshot boundary known per producer
+using SnapshotMap = std::unordered_map<NodeID, uint64_t>;
+
+class PacketPool;
+
 typedef struct Packet_ {
-  std::shared_ptr<const Interest> interest;
+  // Built in place, so queuing takes no allocation of its own
+  Interest interest;
+  // Data shared with whoever else holds it, or else local_data
   std::shared_ptr<const Data> data;
+  Data local_data;
 
   enum PacketType { INTEREST_TYPE, DATA_TYPE } packet_type;
 
+  time::steady_clock::TimePoint enqueue_time;
+
+  // Reply handlers of data interests; sync interests leave them empty
+  DataCallback on_data;
+  NackCallback on_nack;
+  TimeoutCallback on_timeout;
+
+  // Pool the packet returns to, and link of the queue holding it
+  PacketPool *pool = nullptr;
+  struct Packet_ *next = nullptr;
+
+  const Data &getData() const { return data ? *data : local_data; }
+
   // // Define copy constructor to safely copy shared ptr
   // Packet_() : interest(nullptr), data(nullptr){};
   // Packet_(const Packet_ &c)
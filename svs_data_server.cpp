@@ -0,0 +1,132 @@
+#include "svs_data_server.hpp"
+
+#include <algorithm>
+#include <ndn-cxx/interest-filter.hpp>
+
+#include "svs_helper.hpp"
+
+namespace ndn {
+namespace svs {
+
+void DataServer::registerPrefix() {
+  m_face.setInterestFilter(InterestFilter(m_svs.getDataPrefix()),
+                           bind(&DataServer::onDataInterest, this, _2),
+                           nullptr);
+}
+
+void DataServer::insert(std::shared_ptr<const Data> data, bool pin) {
+  const Name &n = data->getName();
+  if (!IsSnapshotName(n)) {
+    m_store.insert(std::move(data), pin);
+    return;
+  }
+  auto &latest = m_snapshots[ExtractNodeID(n)];
+  if (!latest || ExtractSequence(latest->getName()) < ExtractSequence(n))
+    latest = std::move(data);
+}
+
+std::shared_ptr<const Data> DataServer::find(NodeID nid, uint64_t seq) {
+  auto data = m_store.find(nid, seq);
+  // Own data evicted from memory, or published before a restart
+  if (!data && nid == m_svs.getId() && m_svs.getLog())
+    data = m_svs.getLog()->getData(seq);
+  return data;
+}
+
+/**
+ * lookup() - Reply held for the data, snapshot or range segment named n.
+ */
+std::shared_ptr<const Data> DataServer::lookup(const Name &n) {
+  if (IsRangeName(n)) {
+    return m_range_server.getSegment(
+        n, [this](NodeID nid, uint64_t seq) { return find(nid, seq); });
+  }
+  if (IsSnapshotName(n)) {
+    auto it = m_snapshots.find(ExtractNodeID(n));
+    if (it == m_snapshots.end() || it->second->getName() != n) return nullptr;
+    return it->second;
+  }
+  return find(ExtractNodeID(n), ExtractSequence(n));
+}
+
+/**
+ * onDataInterest() - Answer from what this node holds, or maybe forward.
+ */
+void DataServer::onDataInterest(const Interest &interest) {
+  const Name &n = interest.getName();
+  if (n.size() < 3 || ExtractGroupPrefix(n) != m_svs.getDataPrefix()) return;
+
+  // An interest this node forwarded, heard back from a neighbour
+  auto own = m_own_nonces.find(interest.getNonce());
+  if (own != m_own_nonces.end() &&
+      own->second > time::steady_clock::now())
+    return;
+
+  if (auto data = lookup(n)) {
+    ++m_stats.answered;
+    m_svs.sendData(std::move(data));
+    return;
+  }
+
+  std::bernoulli_distribution coin(m_options.forward_probability);
+  if (m_options.forward_probability > 0 && coin(m_rng) && forward(interest))
+    return;
+  ++m_stats.unanswered;
+}
+
+/**
+ * Expire() - Drop entries whose expiry has passed.
+ */
+template <typename Key>
+static void Expire(std::unordered_map<Key, time::steady_clock::TimePoint> &map,
+                   time::steady_clock::TimePoint now) {
+  for (auto it = map.begin(); it != map.end();) {
+    if (it->second <= now)
+      it = map.erase(it);
+    else
+      ++it;
+  }
+}
+
+/**
+ * forward() - Express interest on behalf of the neighbour that sent it, one
+ *  hop less far, and cache and pass on the reply. Return false if its hop
+ *  limit is used up; true also if the name is already being forwarded.
+ */
+bool DataServer::forward(const Interest &interest) {
+  auto hop_limit = interest.getHopLimit();
+  if (hop_limit && *hop_limit <= 1) return false;
+
+  const Name &n = interest.getName();
+  auto now = time::steady_clock::now();
+  Expire(m_forwarded, now);
+  Expire(m_own_nonces, now);
+  auto expiry = now + std::max<time::nanoseconds>(
+                          m_options.forward_suppression,
+                          interest.getInterestLifetime());
+  if (!m_forwarded.emplace(n, expiry).second) return true;
+
+  Interest forwarded(interest);
+  // NFD would take the neighbour's nonce, coming from this node as well,
+  // for a loop. The hop limit bounds real loops instead.
+  forwarded.refreshNonce();
+  forwarded.setHopLimit(static_cast<uint8_t>(
+      hop_limit ? *hop_limit - 1 : m_options.forward_hop_limit));
+  m_own_nonces[forwarded.getNonce()] = expiry;
+
+  ++m_stats.forwarded;
+  m_svs.forwardDataInterest(
+      forwarded,
+      [this](const Interest &, const Data &data) {
+        ++m_stats.answered_forwarded;
+        auto reply = data.shared_from_this();
+        // Range segments are only passed on
+        if (!IsRangeName(data.getName())) insert(reply);
+        m_svs.sendData(reply);
+      },
+      [](const Interest &, const lp::Nack &) {}, [](const Interest &) {});
+  return true;
+}
+
+}  // namespace svs
+}  // namespace ndn
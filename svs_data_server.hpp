@@ -0,0 +1,97 @@
+#pragma once
+
+#include <memory>
+#include <ndn-cxx/face.hpp>
+#include <random>
+#include <unordered_map>
+
+#include "svs.hpp"
+#include "svs_data_store.hpp"
+#include "svs_range_server.hpp"
+
+namespace ndn {
+namespace svs {
+
+struct DataServerOptions {
+  // Chance of forwarding an interest this node cannot answer, so a holder
+  // further away can answer through it. Zero never forwards.
+  double forward_probability = 0;
+  // A name forwarded is not forwarded again for this long, or for the
+  // lifetime of the interest forwarded if longer
+  time::milliseconds forward_suppression = time::milliseconds(1000);
+  // HopLimit given to forwarded interests that arrive without one. Those
+  // arriving with 1 or less are not forwarded, so a miss spreads at most
+  // this many hops.
+  uint8_t forward_hop_limit = 4;
+  RangeServerOptions range;
+};
+
+struct DataServerStats {
+  uint64_t answered = 0;
+  uint64_t forwarded = 0;
+  // Answered through a forwarded interest
+  uint64_t answered_forwarded = 0;
+  uint64_t unanswered = 0;
+};
+
+/**
+ * DataServer - Serves the data prefix of a sync group from everything this
+ *  node holds: its own data, in memory or in the log, and whatever it
+ *  fetched, so fetches are answered by the nearest holder rather than the
+ *  producer alone. Plain, snapshot and range interests are answered; others
+ *  may be forwarded. Runs on the event loop of svs.
+ */
+class DataServer {
+ public:
+  DataServer(SVS &svs, Face &face, KeyChain &keyChain, DataStore &store,
+             const DataServerOptions &options = DataServerOptions())
+      : m_svs(svs),
+        m_face(face),
+        m_store(store),
+        m_range_server(keyChain, options.range),
+        m_options(options),
+        m_rng(std::random_device()()) {}
+
+  /**
+   * registerPrefix() - Receive data interests for the group's data prefix.
+   *  Under a SyncGroupManager, pass onDataInterest() to addGroup() instead.
+   */
+  void registerPrefix();
+
+  /**
+   * insert() - Keep data for serving: snapshots as the latest one of their
+   *  producer, the rest in the data store. With pin, as for DataStore.
+   */
+  void insert(std::shared_ptr<const Data> data, bool pin = false);
+
+  /**
+   * find() - Data of (nid, seq) held, looking in the log for own data.
+   */
+  std::shared_ptr<const Data> find(NodeID nid, uint64_t seq);
+
+  void onDataInterest(const Interest &interest);
+
+  const DataServerStats &getStats() const { return m_stats; }
+
+ private:
+  std::shared_ptr<const Data> lookup(const Name &n);
+
+  bool forward(const Interest &interest);
+
+  SVS &m_svs;
+  Face &m_face;
+  DataStore &m_store;
+  RangeServer m_range_server;
+  const DataServerOptions m_options;
+  DataServerStats m_stats;
+  std::mt19937 m_rng;
+  // Latest snapshot of each producer
+  std::unordered_map<NodeID, std::shared_ptr<const Data>> m_snapshots;
+  // Names forwarded, and nonces of the interests this node forwarded, by
+  // when they expire
+  std::unordered_map<Name, time::steady_clock::TimePoint> m_forwarded;
+  std::unordered_map<uint32_t, time::steady_clock::TimePoint> m_own_nonces;
+};
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,96 @@
+#include "svs_data_store.hpp"
+
+#include "svs_helper.hpp"
+
+namespace ndn {
+namespace svs {
+
+// Rough per-entry cost of the list node, hash node and Data object
+static const size_t kEntryOverhead = sizeof(Data) + 128;
+
+void DataStore::insert(NodeID nid, uint64_t seq,
+                       std::shared_ptr<const Data> data, bool pin) {
+  Key key{nid, seq};
+  auto existing = m_entries.find(key);
+  if (existing != m_entries.end()) erase(existing->second);
+
+  Entry entry;
+  entry.key = key;
+  entry.bytes = data->wireEncode().size() + kEntryOverhead;
+  entry.data = std::move(data);
+  entry.pinned = pin && m_options.retention > time::milliseconds(0);
+  if (entry.pinned)
+    entry.pinned_until = time::steady_clock::now() + m_options.retention;
+
+  m_bytes += entry.bytes;
+  EntryList &list = entry.pinned ? m_pinned : m_lru;
+  auto it = entry.pinned ? list.insert(list.end(), std::move(entry))
+                         : list.insert(list.begin(), std::move(entry));
+  m_entries[key] = it;
+
+  unpinExpired();
+  evict();
+}
+
+void DataStore::insert(std::shared_ptr<const Data> data, bool pin) {
+  const Name &name = data->getName();
+  insert(ExtractNodeID(name), ExtractSequence(name), std::move(data), pin);
+}
+
+std::shared_ptr<const Data> DataStore::find(NodeID nid, uint64_t seq) {
+  auto it = m_entries.find(Key{nid, seq});
+  if (it == m_entries.end()) {
+    ++m_misses;
+    return nullptr;
+  }
+  ++m_hits;
+  if (!it->second->pinned) m_lru.splice(m_lru.begin(), m_lru, it->second);
+  return it->second->data;
+}
+
+std::shared_ptr<const Data> DataStore::find(const Name &name) {
+  return find(ExtractNodeID(name), ExtractSequence(name));
+}
+
+DataStoreStats DataStore::getStats() const {
+  DataStoreStats stats;
+  stats.hits = m_hits;
+  stats.misses = m_misses;
+  stats.evictions = m_evictions;
+  stats.entries = m_entries.size();
+  stats.pinned = m_pinned.size();
+  stats.bytes = m_bytes;
+  return stats;
+}
+
+/**
+ * unpinExpired() - Move entries whose retention window has passed to the
+ *  LRU end of the unpinned list, making them the first to go.
+ */
+void DataStore::unpinExpired() {
+  auto now = time::steady_clock::now();
+  while (!m_pinned.empty() && m_pinned.front().pinned_until <= now) {
+    m_pinned.front().pinned = false;
+    m_lru.splice(m_lru.end(), m_pinned, m_pinned.begin());
+  }
+}
+
+/**
+ * evict() - Drop least recently used unpinned entries until the store fits
+ *  its budget or only pinned entries remain.
+ */
+void DataStore::evict() {
+  while (m_bytes > m_options.max_bytes && !m_lru.empty()) {
+    erase(std::prev(m_lru.end()));
+    ++m_evictions;
+  }
+}
+
+void DataStore::erase(EntryList::iterator it) {
+  m_bytes -= it->bytes;
+  m_entries.erase(it->key);
+  (it->pinned ? m_pinned : m_lru).erase(it);
+}
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <ndn-cxx/data.hpp>
+#include <unordered_map>
+
+#include "svs_common.hpp"
+
+namespace ndn {
+namespace svs {
+
+struct DataStoreOptions {
+  // Budget for stored packets, counted as wire size plus bookkeeping
+  size_t max_bytes = 64 * 1024 * 1024;
+  // Locally published data is never evicted before this much time has
+  // passed, so neighbours can still fetch it. It may push the store over
+  // budget meanwhile.
+  time::milliseconds retention = time::milliseconds(60000);
+};
+
+struct DataStoreStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  size_t entries = 0;
+  size_t pinned = 0;
+  size_t bytes = 0;
+};
+
+/**
+ * DataStore - Data packets keyed by (NodeID, seq) under a byte budget.
+ *  Lookups are O(1); when full, the least recently used unpinned packet is
+ *  evicted first. Not thread-safe.
+ */
+class DataStore {
+ public:
+  explicit DataStore(const DataStoreOptions &options = DataStoreOptions())
+      : m_options(options) {}
+
+  /**
+   * insert() - Store data as (nid, seq), replacing any packet stored there.
+   *  With pin, it survives eviction for the retention window.
+   */
+  void insert(NodeID nid, uint64_t seq, std::shared_ptr<const Data> data,
+              bool pin = false);
+
+  /**
+   * insert() - Store data under the (NodeID, seq) of its name, as built by
+   *  MakeDataName().
+   */
+  void insert(std::shared_ptr<const Data> data, bool pin = false);
+
+  /**
+   * find() - Return the packet stored as (nid, seq) and mark it recently
+   *  used, or nullptr.
+   */
+  std::shared_ptr<const Data> find(NodeID nid, uint64_t seq);
+
+  std::shared_ptr<const Data> find(const Name &name);
+
+  // Unlike find(), neither counts a hit or miss nor touches LRU order
+  bool contains(NodeID nid, uint64_t seq) const {
+    return m_entries.count(Key{nid, seq}) > 0;
+  }
+
+  DataStoreStats getStats() const;
+
+ private:
+  struct Key {
+    NodeID nid;
+    uint64_t seq;
+    bool operator==(const Key &o) const { return nid == o.nid && seq == o.seq; }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      return std::hash<uint64_t>()(key.nid * 0x9E3779B97F4A7C15ULL ^ key.seq);
+    }
+  };
+
+  struct Entry {
+    Key key;
+    std::shared_ptr<const Data> data;
+    size_t bytes;
+    bool pinned;
+    time::steady_clock::TimePoint pinned_until;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  void unpinExpired();
+
+  void evict();
+
+  void erase(EntryList::iterator it);
+
+  const DataStoreOptions m_options;
+  // Unpinned entries, most recently used first
+  EntryList m_lru;
+  // Pinned entries in pinning order, which is also expiry order
+  EntryList m_pinned;
+  std::unordered_map<Key, EntryList::iterator, KeyHash> m_entries;
+  size_t m_bytes = 0;
+  uint64_t m_hits = 0;
+  uint64_t m_misses = 0;
+  uint64_t m_evictions = 0;
+};
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,385 @@
+#include "svs_fetcher.hpp"
+
+#include <algorithm>
+
+#include "svs_helper.hpp"
+
+namespace ndn {
+namespace svs {
+
+/**
+ * fetch() - Attach callbacks to an existing request for name, or queue a new
+ *  one behind the producer's window.
+ */
+void Fetcher::fetch(const Name &name, NodeID producer,
+                    const DataCallback &onData,
+                    const FailureCallback &onFailure) {
+  auto it = m_requests.find(name);
+  if (it == m_requests.end()) {
+    it = m_requests.emplace(name, Request()).first;
+    it->second.producer = producer;
+    getProducer(producer).queue.push_back(name);
+  }
+  if (onData) it->second.on_data.push_back(onData);
+  if (onFailure) it->second.on_failure.push_back(onFailure);
+
+  schedulePending(producer);
+}
+
+/**
+ * fetchUpdates() - Expand each missing range into data names and fetch them,
+ *  after the snapshot the range starts from, if any.
+ */
+void Fetcher::fetchUpdates(const std::vector<MissingDataInfo> &updates,
+                           const DataCallback &onData,
+                           const FailureCallback &onFailure) {
+  for (const auto &update : updates) {
+    if (update.snapshotSeq != 0) {
+      // Only this node may hold an older snapshot; without it, the
+      // history it covers goes by name
+      NodeID producer = update.nodeID;
+      uint64_t snapshot_seq = update.snapshotSeq;
+      fetch(MakeSnapshotName(m_options.data_prefix, producer, snapshot_seq),
+            producer, onData,
+            [this, producer, snapshot_seq, onData, onFailure](const Name &) {
+              fetchSeqs(producer, 1, snapshot_seq, onData, onFailure);
+            });
+    }
+    // Empty if the snapshot covers the whole range
+    fetchSeqs(update.nodeID, update.lowSeq, update.highSeq, onData, onFailure);
+  }
+}
+
+/**
+ * fetchSeqs() - Fetch the Data of producer in low..high, in ranges of up to
+ *  max_range sequence numbers if enabled. Nothing if low > high.
+ */
+void Fetcher::fetchSeqs(NodeID producer, uint64_t low, uint64_t high,
+                        const DataCallback &onData,
+                        const FailureCallback &onFailure) {
+  if (low > high) return;
+  if (m_options.max_range > 0 && high > low) {
+    for (uint64_t first = low;;) {
+      uint64_t last = high - first >= m_options.max_range
+                          ? first + m_options.max_range - 1
+                          : high;
+      fetchRange(producer, first, last, onData, onFailure);
+      if (last == high) break;
+      first = last + 1;
+    }
+    return;
+  }
+  for (uint64_t seq = low; seq <= high; ++seq) {
+    fetch(MakeDataName(m_options.data_prefix, producer, seq), producer, onData,
+          onFailure);
+  }
+}
+
+/**
+ * fetchRange() - Attach callbacks to a range fetch in progress, or start
+ *  one with its first segment, which tells how many follow.
+ */
+void Fetcher::fetchRange(NodeID producer, uint64_t low, uint64_t high,
+                         const DataCallback &onData,
+                         const FailureCallback &onFailure) {
+  Name range_name = MakeRangeName(m_options.data_prefix, producer, low, high);
+  auto it = m_ranges.find(range_name);
+  bool started = it != m_ranges.end();
+  if (!started) {
+    it = m_ranges.emplace(range_name, RangeRequest()).first;
+    it->second.producer = producer;
+    it->second.low = low;
+    it->second.high = high;
+  }
+  if (onData) it->second.on_data.push_back(onData);
+  if (onFailure) it->second.on_failure.push_back(onFailure);
+  if (started) return;
+
+  // A segment lost for good makes the whole range go by name
+  fetch(Name(range_name).appendSegment(0), producer,
+        [this, range_name](const Data &segment) {
+          onRangeSegment(range_name, segment);
+        },
+        [this, range_name](const Name &) {
+          fetchRangeByName(range_name, std::vector<bool>());
+        });
+}
+
+/**
+ * onRangeSegment() - Keep a segment of a range reply; the first one also
+ *  queues the others. Segments disagreeing on the count come from
+ *  differing streams and abandon the reply.
+ */
+void Fetcher::onRangeSegment(const Name &range_name, const Data &segment) {
+  auto it = m_ranges.find(range_name);
+  if (it == m_ranges.end()) return;
+  RangeRequest &range = it->second;
+  const std::vector<bool> none;
+
+  const auto &final_block = segment.getFinalBlock();
+  const auto &last = segment.getName().get(-1);
+  if (!final_block || !final_block->isSegment() || !last.isSegment()) {
+    fetchRangeByName(range_name, none);
+    return;
+  }
+  uint64_t count = final_block->toSegment() + 1;
+  uint64_t number = last.toSegment();
+  if (range.segments.empty()) {
+    // Bound what a bogus reply can make us fetch and buffer
+    if (count > (range.high - range.low + 1) * 64) {
+      fetchRangeByName(range_name, none);
+      return;
+    }
+    range.segments.resize(count);
+    range.received.assign(count, false);
+    range.remaining = count;
+    for (uint64_t i = 1; i < count; ++i) {
+      fetch(Name(range_name).appendSegment(i), range.producer,
+            [this, range_name](const Data &next) {
+              onRangeSegment(range_name, next);
+            },
+            [this, range_name](const Name &) {
+              fetchRangeByName(range_name, std::vector<bool>());
+            });
+    }
+  }
+  if (count != range.segments.size() || number >= count) {
+    fetchRangeByName(range_name, none);
+    return;
+  }
+  if (range.received[number]) return;
+
+  const auto &content = segment.getContent();
+  range.segments[number].assign(
+      reinterpret_cast<const char *>(content.value()), content.value_size());
+  range.received[number] = true;
+  if (--range.remaining == 0) completeRange(range_name);
+}
+
+/**
+ * completeRange() - Split the reassembled stream into Data packets and
+ *  deliver those of the range, then fetch the missing ones by name.
+ */
+void Fetcher::completeRange(const Name &range_name) {
+  auto it = m_ranges.find(range_name);
+  RangeRequest &range = it->second;
+  std::string stream;
+  for (const auto &segment : range.segments) stream += segment;
+
+  std::vector<bool> delivered(range.high - range.low + 1, false);
+  // Owned by shared_ptr like Data from the face, so callbacks may keep them
+  std::vector<std::shared_ptr<const Data>> packets;
+  const uint8_t *cur = reinterpret_cast<const uint8_t *>(stream.data());
+  const uint8_t *end = cur + stream.size();
+  while (cur != end) {
+    auto data = std::make_shared<Data>();
+    try {
+      Block wire(cur, end - cur);
+      cur += wire.size();
+      data->wireDecode(wire);
+    } catch (const tlv::Error &) {
+      break;
+    }
+    // Only the range's own names count
+    const Name &n = data->getName();
+    if (n.size() < 3 || ExtractGroupPrefix(n) != m_options.data_prefix ||
+        ExtractNodeID(n) != range.producer || IsSnapshotName(n))
+      continue;
+    uint64_t seq = ExtractSequence(n);
+    if (seq < range.low || seq > range.high || delivered[seq - range.low])
+      continue;
+    delivered[seq - range.low] = true;
+    packets.push_back(std::move(data));
+  }
+
+  auto callbacks = range.on_data;
+  fetchRangeByName(range_name, delivered);
+  for (const auto &packet : packets) {
+    for (const auto &callback : callbacks) callback(*packet);
+  }
+}
+
+/**
+ * fetchRangeByName() - End the range fetch of range_name, fetching every
+ *  sequence number not delivered by name. An empty delivered means none
+ *  was.
+ */
+void Fetcher::fetchRangeByName(const Name &range_name,
+                               const std::vector<bool> &delivered) {
+  auto it = m_ranges.find(range_name);
+  if (it == m_ranges.end()) return;
+  RangeRequest range = std::move(it->second);
+  m_ranges.erase(it);
+
+  // Segments still outstanding would only hold window slots and retry
+  for (uint64_t i = 0; i < std::max<size_t>(range.segments.size(), 1); ++i)
+    cancel(Name(range_name).appendSegment(i));
+  schedulePending(range.producer);
+
+  for (uint64_t seq = range.low; seq <= range.high; ++seq) {
+    if (!delivered.empty() && delivered[seq - range.low]) continue;
+    Name name = MakeDataName(m_options.data_prefix, range.producer, seq);
+    for (const auto &callback : range.on_data)
+      fetch(name, range.producer, callback);
+    for (const auto &callback : range.on_failure)
+      fetch(name, range.producer, nullptr, callback);
+  }
+}
+
+Fetcher::ProducerState &Fetcher::getProducer(NodeID producer) {
+  auto it = m_producers.find(producer);
+  if (it == m_producers.end()) {
+    ProducerState state;
+    state.cwnd = m_options.initial_window;
+    state.ssthresh = m_options.max_window;
+    state.rto = m_options.initial_rto;
+    it = m_producers.emplace(producer, state).first;
+  }
+  return it->second;
+}
+
+/**
+ * schedulePending() - Send queued names of producer while its window allows.
+ */
+void Fetcher::schedulePending(NodeID producer) {
+  ProducerState &state = getProducer(producer);
+  while (!state.queue.empty() &&
+         state.in_flight < static_cast<size_t>(state.cwnd)) {
+    Name name = state.queue.front();
+    state.queue.pop_front();
+
+    auto it = m_requests.find(name);
+    if (it == m_requests.end() || it->second.in_flight) continue;
+    ++state.in_flight;
+    expressRequest(name, it->second);
+  }
+}
+
+void Fetcher::expressRequest(const Name &name, Request &request) {
+  const ProducerState &state = getProducer(request.producer);
+  Interest interest(name,
+                    time::duration_cast<time::milliseconds>(state.rto));
+  request.in_flight = true;
+  request.sent_time = time::steady_clock::now();
+
+  auto on_data = std::bind(&Fetcher::onData, this, _1, _2);
+  auto on_nack = std::bind(&Fetcher::onNack, this, _1, _2);
+  auto on_timeout = std::bind(&Fetcher::onTimeout, this, _1);
+  if (m_send)
+    m_send(interest, on_data, on_nack, on_timeout);
+  else
+    m_face.expressInterest(interest, on_data, on_nack, on_timeout);
+}
+
+/**
+ * cancel() - Drop the request for name without calling its callbacks,
+ *  releasing its window slot if in flight. A reply arriving later is
+ *  ignored.
+ */
+void Fetcher::cancel(const Name &name) {
+  auto it = m_requests.find(name);
+  if (it == m_requests.end()) return;
+  if (it->second.in_flight) --getProducer(it->second.producer).in_flight;
+  // A queued entry is skipped once the request is gone
+  m_requests.erase(it);
+}
+
+/**
+ * onData() - Grow the window, sample RTT for first transmissions only
+ *  (Karn's algorithm), and complete the request.
+ */
+void Fetcher::onData(const Interest &interest, const Data &data) {
+  auto it = m_requests.find(interest.getName());
+  if (it == m_requests.end() || !it->second.in_flight) return;
+
+  NodeID producer = it->second.producer;
+  ProducerState &state = getProducer(producer);
+  --state.in_flight;
+  if (it->second.retries == 0)
+    addRttSample(state, time::steady_clock::now() - it->second.sent_time);
+  if (state.cwnd < state.ssthresh)
+    state.cwnd += 1;
+  else
+    state.cwnd += 1 / state.cwnd;
+  state.cwnd = std::min(state.cwnd, m_options.max_window);
+
+  // Callbacks may fetch again, so detach the request first
+  auto callbacks = std::move(it->second.on_data);
+  m_requests.erase(it);
+  for (const auto &callback : callbacks) callback(data);
+
+  schedulePending(producer);
+}
+
+/**
+ * onNack() - Congestion Nacks shrink the window like a timeout; other
+ *  reasons leave it alone and retry after one RTO.
+ */
+void Fetcher::onNack(const Interest &interest, const lp::Nack &nack) {
+  retry(interest.getName(),
+        nack.getReason() == lp::NackReason::CONGESTION);
+}
+
+void Fetcher::onTimeout(const Interest &interest) {
+  retry(interest.getName(), true);
+}
+
+/**
+ * retry() - Release the window slot of a failed attempt and requeue the name
+ *  at the front of its producer queue, or report failure once
+ *  max_retries is exceeded.
+ */
+void Fetcher::retry(const Name &name, bool congested) {
+  auto it = m_requests.find(name);
+  if (it == m_requests.end() || !it->second.in_flight) return;
+
+  NodeID producer = it->second.producer;
+  ProducerState &state = getProducer(producer);
+  --state.in_flight;
+  it->second.in_flight = false;
+
+  if (congested) {
+    state.ssthresh = std::max(state.cwnd / 2, 1.0);
+    state.cwnd = state.ssthresh;
+    state.rto = std::min<time::nanoseconds>(state.rto * 2, m_options.max_rto);
+  }
+
+  if (++it->second.retries > m_options.max_retries) {
+    auto callbacks = std::move(it->second.on_failure);
+    m_requests.erase(it);
+    for (const auto &callback : callbacks) callback(name);
+    schedulePending(producer);
+    return;
+  }
+
+  if (congested) {
+    state.queue.push_front(name);
+    schedulePending(producer);
+  } else {
+    m_scheduler.schedule(state.rto, [this, name, producer] {
+      if (m_requests.find(name) == m_requests.end()) return;
+      getProducer(producer).queue.push_front(name);
+      schedulePending(producer);
+    });
+  }
+}
+
+/**
+ * addRttSample() - Update smoothed RTT and RTO as in RFC 6298.
+ */
+void Fetcher::addRttSample(ProducerState &state, time::nanoseconds rtt) {
+  if (state.srtt == time::nanoseconds::zero()) {
+    state.srtt = rtt;
+    state.rttvar = rtt / 2;
+  } else {
+    time::nanoseconds err = state.srtt > rtt ? state.srtt - rtt : rtt - state.srtt;
+    state.rttvar = (state.rttvar * 3 + err) / 4;
+    state.srtt = (state.srtt * 7 + rtt) / 8;
+  }
+  time::nanoseconds rto = state.srtt + state.rttvar * 4;
+  state.rto = std::max<time::nanoseconds>(
+      m_options.min_rto, std::min<time::nanoseconds>(rto, m_options.max_rto));
+}
+
+}  // namespace svs
+}  // namespace ndn
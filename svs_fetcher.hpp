@@ -0,0 +1,162 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include "svs_common.hpp"
+
+namespace ndn {
+namespace svs {
+
+struct FetcherOptions {
+  // Data prefix of the sync group, see SVSOptions::data_prefix
+  Name data_prefix = kSyncDataPrefix;
+  // Outstanding interests allowed per producer before the first loss
+  double initial_window = 4;
+  double max_window = 64;
+  // Retransmissions after the first attempt before giving up on a name
+  int max_retries = 3;
+  time::milliseconds initial_rto = time::milliseconds(1000);
+  time::milliseconds min_rto = time::milliseconds(200);
+  time::milliseconds max_rto = time::milliseconds(8000);
+  // Fetch missing ranges longer than one sequence number with range
+  // interests of up to this many sequence numbers each (see RangeServer);
+  // whatever a range reply lacks is fetched one name at a time. Zero
+  // fetches every sequence number by its own name.
+  size_t max_range = 0;
+};
+
+/**
+ * Fetcher - Retrieves data names through a per-producer window of
+ *  outstanding interests. The window grows additively on every reply and is
+ *  halved on timeout or congestion Nack (AIMD). Interest lifetime follows an
+ *  RFC 6298 retransmission timeout measured per producer. Names already
+ *  queued or in flight are not requested again; their callbacks are attached
+ *  to the existing request.
+ */
+class Fetcher {
+ public:
+  // Sends an interest and calls exactly one of the callbacks, on the
+  // fetcher's event loop, e.g. SVS::sendDataInterest()
+  using SendInterest = std::function<void(
+      const Interest &, const ndn::DataCallback &, const NackCallback &,
+      const TimeoutCallback &)>;
+  using DataCallback = std::function<void(const Data &)>;
+  using FailureCallback = std::function<void(const Name &)>;
+
+  /**
+   * Fetcher() - Without send, interests go straight to face. Pass
+   *  SVS::sendDataInterest() instead so fetches queue behind sync traffic.
+   */
+  Fetcher(Face &face, Scheduler &scheduler,
+          const FetcherOptions &options = FetcherOptions(),
+          const SendInterest &send = nullptr)
+      : m_face(face),
+        m_scheduler(scheduler),
+        m_options(options),
+        m_send(send) {}
+
+  /**
+   * fetch() - Queue name for retrieval from producer. onData is called once
+   *  with the reply; onFailure once retransmissions are exhausted.
+   */
+  void fetch(const Name &name, NodeID producer, const DataCallback &onData,
+             const FailureCallback &onFailure = nullptr);
+
+  /**
+   * fetchRange() - Fetch the Data of producer in low..high as one segmented
+   *  range reply. onData is called once per Data; sequence numbers the
+   *  reply lacks are fetched by name.
+   */
+  void fetchRange(NodeID producer, uint64_t low, uint64_t high,
+                  const DataCallback &onData,
+                  const FailureCallback &onFailure = nullptr);
+
+  /**
+   * fetchUpdates() - Queue every data name of a sync update batch, and the
+   *  snapshots they start from. A snapshot that cannot be fetched is
+   *  replaced by the history it covers.
+   */
+  void fetchUpdates(const std::vector<MissingDataInfo> &updates,
+                    const DataCallback &onData,
+                    const FailureCallback &onFailure = nullptr);
+
+  // Number of names queued or in flight, range segments included
+  size_t getPendingCount() const { return m_requests.size(); }
+
+ private:
+  struct Request {
+    NodeID producer;
+    std::vector<DataCallback> on_data;
+    std::vector<FailureCallback> on_failure;
+    int retries = 0;
+    bool in_flight = false;
+    time::steady_clock::TimePoint sent_time;
+  };
+
+  struct RangeRequest {
+    NodeID producer;
+    uint64_t low;
+    uint64_t high;
+    std::vector<DataCallback> on_data;
+    std::vector<FailureCallback> on_failure;
+    // Contents by segment number, sized once segment 0 tells the count
+    std::vector<std::string> segments;
+    std::vector<bool> received;
+    size_t remaining = 0;
+  };
+
+  struct ProducerState {
+    double cwnd;
+    double ssthresh;
+    size_t in_flight = 0;
+    time::nanoseconds srtt = time::nanoseconds::zero();
+    time::nanoseconds rttvar = time::nanoseconds::zero();
+    time::nanoseconds rto;
+    std::deque<Name> queue;
+  };
+
+  ProducerState &getProducer(NodeID producer);
+
+  void schedulePending(NodeID producer);
+
+  void fetchSeqs(NodeID producer, uint64_t low, uint64_t high,
+                 const DataCallback &onData, const FailureCallback &onFailure);
+
+  void expressRequest(const Name &name, Request &request);
+
+  void cancel(const Name &name);
+
+  void onData(const Interest &interest, const Data &data);
+
+  void onNack(const Interest &interest, const lp::Nack &nack);
+
+  void onTimeout(const Interest &interest);
+
+  void retry(const Name &name, bool congested);
+
+  void addRttSample(ProducerState &producer, time::nanoseconds rtt);
+
+  void onRangeSegment(const Name &range_name, const Data &segment);
+
+  void completeRange(const Name &range_name);
+
+  void fetchRangeByName(const Name &range_name,
+                        const std::vector<bool> &delivered);
+
+  Face &m_face;
+  Scheduler &m_scheduler;
+  const FetcherOptions m_options;
+  const SendInterest m_send;
+  std::unordered_map<Name, Request> m_requests;
+  std::unordered_map<NodeID, ProducerState> m_producers;
+  // Range fetches in progress by range name (without segment)
+  std::unordered_map<Name, RangeRequest> m_ranges;
+};
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,383 @@
+#include "svs_group_manager.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/interest-filter.hpp>
+
+#include "svs_helper.hpp"
+
+namespace ndn {
+namespace svs {
+
+SyncGroupManager::SyncGroupManager(NodeID id, Face *face,
+                                   const SyncGroupManagerOptions &options)
+    : m_id(id),
+      m_options(options),
+      m_batch_prefix(Name(options.root_prefix)
+                         .append(reinterpret_cast<const uint8_t *>(
+                                     kSyncBatchComponent),
+                                 sizeof(kSyncBatchComponent) - 1)),
+      m_owned_face(face ? nullptr : new Face()),
+      m_face(face ? *face : *m_owned_face),
+      m_scheduler(m_face.getIoService()),
+      m_tx_bucket(options.tx_rate, options.tx_burst),
+      m_tx_queue(options.tx_classes) {}
+
+SVS *SyncGroupManager::addGroup(NodeID nid,
+                                const SyncUpdateCallback &processSyncUpdate,
+                                const SVSOptions &options,
+                                const DataInterestCallback &onDataInterest) {
+  if (!m_options.root_prefix.isPrefixOf(options.sync_prefix) ||
+      !m_options.root_prefix.isPrefixOf(options.data_prefix) ||
+      options.sync_prefix == m_batch_prefix ||
+      options.data_prefix == m_batch_prefix) {
+    std::cerr << "Group prefixes " << options.sync_prefix << " and "
+              << options.data_prefix << " must lie under "
+              << m_options.root_prefix << std::endl;
+    return nullptr;
+  }
+  if (findProducer(options.sync_prefix, nid)) return nullptr;
+
+  std::unique_ptr<Group> group(new Group());
+  group->svs.reset(new SVS(nid, processSyncUpdate, &m_face, &m_scheduler,
+                           &m_keyChain, options));
+  group->on_data_interest = onDataInterest;
+  Group *added = group.get();
+  added->svs->m_sync_interest_sink = [this, added](const Name &n) {
+    onSyncInterestBuilt(*added, n);
+  };
+  m_sync_groups[options.sync_prefix].push_back(added);
+  m_data_groups[options.data_prefix].push_back(added);
+  m_groups.push_back(std::move(group));
+
+  if (m_started) added->svs->start();
+  return added->svs.get();
+}
+
+/**
+ * registerPrefix() - Register the one interest filter all groups share.
+ */
+void SyncGroupManager::registerPrefix() {
+  m_face.setInterestFilter(InterestFilter(m_options.root_prefix),
+                           bind(&SyncGroupManager::onInterest, this, _2),
+                           nullptr);
+}
+
+/**
+ * run() - Start every group and enter the event loop.
+ */
+void SyncGroupManager::run() {
+  start();
+  m_face.processEvents();
+}
+
+/**
+ * start() - Start every group on the calling thread, which must be the one
+ *  running the face's io_service. Groups added later start right away.
+ */
+void SyncGroupManager::start() {
+  m_started = true;
+  for (const auto &group : m_groups) group->svs->start();
+}
+
+/**
+ * onInterest() - Dispatch an interest under the root prefix to the groups
+ *  whose sync or data prefix it carries.
+ */
+void SyncGroupManager::onInterest(const Interest &interest) {
+  const Name &n = interest.getName();
+  if (n.size() < m_options.root_prefix.size() + 3) return;
+  Name group_prefix = ExtractGroupPrefix(n);
+
+  if (group_prefix == m_batch_prefix) {
+    onBatchInterest(interest);
+    return;
+  }
+
+  auto sync_it = m_sync_groups.find(group_prefix);
+  if (sync_it != m_sync_groups.end()) {
+    NodeID producer = ExtractNodeID(n);
+    auto now = time::steady_clock::now();
+    for (Group *group : sync_it->second) {
+      // Managers sending this group unbatched send it in batches as well
+      auto batched = group->batched_producers.find(producer);
+      if (batched == group->batched_producers.end() ||
+          batched->second + m_options.neighbour_lifetime < now)
+        group->last_plain_heard = now;
+      group->svs->onSyncInterest(interest);
+    }
+    return;
+  }
+
+  auto data_it = m_data_groups.find(group_prefix);
+  if (data_it == m_data_groups.end()) return;
+  // The producer named serves its own data; any other producer of the
+  // group may serve what it keeps
+  Group *handler = nullptr;
+  for (Group *group : data_it->second) {
+    if (!group->on_data_interest) continue;
+    if (!handler || group->svs->getId() == ExtractNodeID(n)) handler = group;
+  }
+  if (handler) handler->on_data_interest(interest);
+}
+
+/**
+ * onBatchInterest() - Deliver each sync interest of a batch to the groups
+ *  hosting it, and answer the batch with one Data carrying the immediate
+ *  ACKs they produce.
+ */
+void SyncGroupManager::onBatchInterest(const Interest &interest) {
+  const Name &n = interest.getName();
+  NodeID sender = ExtractNodeID(n);
+  if (sender == m_id) return;
+
+  SyncBatch batch;
+  const auto &encoded = ExtractEncodedVVComponent(n);
+  if (!DecodeSyncBatch(encoded.value(), encoded.value_size(), batch)) return;
+
+  auto now = time::steady_clock::now();
+  SyncBatch acks;
+  for (const auto &entry : batch) {
+    if (entry.first.size() < 3) continue;
+    auto it = m_sync_groups.find(ExtractGroupPrefix(entry.first));
+    if (it == m_sync_groups.end()) continue;
+
+    for (Group *group : it->second) {
+      group->neighbours[sender] = now;
+      group->batched_producers[ExtractNodeID(entry.first)] = now;
+      deliverSyncInterest(*group, entry.first, [&](const Block &content) {
+        acks.emplace_back(
+            entry.first,
+            std::string(reinterpret_cast<const char *>(content.value()),
+                        content.value_size()));
+      });
+    }
+  }
+  if (acks.empty()) return;
+
+  PacketPtr packet = m_packet_pool.acquire();
+  packet->packet_type = Packet::DATA_TYPE;
+  Data &data = packet->local_data;
+  data.setName(n);
+  std::string content = EncodeSyncBatch(acks);
+  data.setContent(reinterpret_cast<const uint8_t *>(content.data()),
+                  content.size());
+  data.setFreshnessPeriod(time::milliseconds(4000));
+  m_keyChain.sign(data, m_signing_info);
+  enqueuePacket(kTxAck, std::move(packet));
+}
+
+/**
+ * onBatchAck() - Hand each ACK in the reply to a batch to the producer
+ *  whose sync interest it answers.
+ */
+void SyncGroupManager::onBatchAck(const Data &data) {
+  SyncBatch acks;
+  const auto &content = data.getContent();
+  if (!DecodeSyncBatch(content.value(), content.value_size(), acks)) return;
+
+  for (const auto &ack : acks) {
+    if (ack.first.size() < 3) continue;
+    Group *group =
+        findProducer(ExtractGroupPrefix(ack.first), ExtractNodeID(ack.first));
+    if (!group) continue;
+
+    Data vv_ack(ack.first);
+    vv_ack.setContent(makeBinaryBlock(
+        tlv::Content, reinterpret_cast<const uint8_t *>(ack.second.data()),
+        ack.second.size()));
+    group->svs->onSyncAck(vv_ack);
+  }
+}
+
+/**
+ * deliverSyncInterest() - Pass sync interest n to group, with its immediate
+ *  ACK going to ack_sink rather than the face.
+ */
+void SyncGroupManager::deliverSyncInterest(
+    Group &group, const Name &n,
+    const std::function<void(const Block &)> &ack_sink) {
+  group.svs->m_ack_sink = ack_sink;
+  group.svs->onSyncInterest(Interest(n));
+  group.svs->m_ack_sink = nullptr;
+}
+
+/**
+ * onSyncInterestBuilt() - Take over sync interest n of group: show it to
+ *  the group's other producers on this node, then send it unbatched or
+ *  queue it for the next flushBatches().
+ */
+void SyncGroupManager::onSyncInterestBuilt(Group &group, const Name &n) {
+  // Through the face, producers on the same face never hear each other.
+  // Deliver asynchronously, as the network would.
+  for (Group *peer : m_sync_groups[group.svs->getSyncPrefix()]) {
+    if (peer == &group) continue;
+    Group *sender = &group;
+    m_face.getIoService().post([this, sender, peer, n] {
+      deliverSyncInterest(*peer, n, [this, sender, n](const Block &content) {
+        m_face.getIoService().post([sender, n, content] {
+          Data ack(n);
+          ack.setContent(content);
+          sender->svs->onSyncAck(ack);
+        });
+      });
+    });
+  }
+
+  if (!m_options.batch_sync_interests) {
+    group.svs->queueSyncInterest(n);
+    return;
+  }
+  if (hasPlainNeighbours(group)) group.svs->queueSyncInterest(n);
+
+  bool replaced = false;
+  for (auto &outgoing : m_outgoing) {
+    if (outgoing.first == &group) {
+      outgoing.second = n;
+      replaced = true;
+    }
+  }
+  if (!replaced) m_outgoing.emplace_back(&group, n);
+
+  if (!m_flush_posted) {
+    m_flush_posted = true;
+    m_face.getIoService().post([this] { flushBatches(); });
+  }
+}
+
+/**
+ * flushBatches() - Send the queued sync interests, one batch per set of
+ *  neighbours. Groups without known neighbours yet share a batch.
+ */
+void SyncGroupManager::flushBatches() {
+  m_flush_posted = false;
+
+  std::map<std::vector<NodeID>, std::vector<Name>> by_neighbours;
+  for (const auto &outgoing : m_outgoing) {
+    by_neighbours[liveNeighbours(*outgoing.first)].push_back(outgoing.second);
+    outgoing.first->svs->m_metrics.sync_interests_sent.increment();
+  }
+  m_outgoing.clear();
+
+  for (const auto &neighbours : by_neighbours) {
+    SyncBatch batch;
+    size_t batch_size = 0;
+    for (const auto &n : neighbours.second) {
+      // Name plus two short varints
+      size_t entry_size = n.wireEncode().size() + 4;
+      if (!batch.empty() && batch_size + entry_size > m_options.max_batch_size) {
+        sendBatch(batch);
+        batch.clear();
+        batch_size = 0;
+      }
+      batch.emplace_back(n, std::string());
+      batch_size += entry_size;
+    }
+    if (!batch.empty()) sendBatch(batch);
+  }
+}
+
+void SyncGroupManager::sendBatch(const SyncBatch &batch) {
+  auto cur_time_ms = time::toUnixTimestamp(time::system_clock::now());
+  PacketPtr packet = m_packet_pool.acquire();
+  packet->packet_type = Packet::INTEREST_TYPE;
+  packet->interest = Interest(MakeSyncBatchName(m_options.root_prefix, m_id,
+                                                EncodeSyncBatch(batch),
+                                                cur_time_ms.count()),
+                              time::milliseconds(1000));
+  // Groups retransmit on their own timers
+  packet->on_data = bind(&SyncGroupManager::onBatchAck, this, _2);
+  packet->on_nack = [](const Interest &, const lp::Nack &) {};
+  packet->on_timeout = [](const Interest &) {};
+  enqueuePacket(kTxSyncInterest, std::move(packet));
+}
+
+/**
+ * enqueuePacket() - Add packet to the queue of tx_class and wake the sender.
+ *  Must run on the event loop thread.
+ */
+void SyncGroupManager::enqueuePacket(TxClass tx_class, PacketPtr packet) {
+  packet->enqueue_time = time::steady_clock::now();
+  if (m_tx_queue.enqueue(tx_class, std::move(packet))) scheduleTransmit();
+  // Nobody waits on dropped batches or replies
+  while (m_tx_queue.takeDropped()) {
+  }
+}
+
+/**
+ * scheduleTransmit() - If any packet is queued and no send is pending,
+ *  schedule transmit() for when the token bucket allows it.
+ */
+void SyncGroupManager::scheduleTransmit() {
+  if (m_tx_event || m_tx_queue.empty()) return;
+  m_tx_event = m_scheduler.schedule(m_tx_bucket.timeUntilAvailable(),
+                                    [this] { transmit(); });
+}
+
+/**
+ * transmit() - Send the next batch interest or reply the scheduler picks,
+ *  as paced by the token bucket.
+ */
+void SyncGroupManager::transmit() {
+  if (m_tx_bucket.consume()) {
+    if (PacketPtr packet = m_tx_queue.dequeue()) {
+      if (packet->packet_type == Packet::INTEREST_TYPE)
+        m_face.expressInterest(packet->interest, packet->on_data,
+                               packet->on_nack, packet->on_timeout);
+      else
+        m_face.put(packet->getData());
+    }
+    while (m_tx_queue.takeDropped()) {
+    }
+  }
+  scheduleTransmit();
+}
+
+/**
+ * Forget() - Drop entries last heard before horizon.
+ */
+static void Forget(std::unordered_map<NodeID, time::steady_clock::TimePoint> &heard,
+                   time::steady_clock::TimePoint horizon) {
+  for (auto it = heard.begin(); it != heard.end();) {
+    if (it->second < horizon)
+      it = heard.erase(it);
+    else
+      ++it;
+  }
+}
+
+/**
+ * liveNeighbours() - Managers heard carrying group within the neighbour
+ *  lifetime, sorted. Forgets the others.
+ */
+std::vector<NodeID> SyncGroupManager::liveNeighbours(Group &group) {
+  auto horizon = time::steady_clock::now() - m_options.neighbour_lifetime;
+  Forget(group.neighbours, horizon);
+  Forget(group.batched_producers, horizon);
+
+  std::vector<NodeID> live;
+  for (const auto &neighbour : group.neighbours) live.push_back(neighbour.first);
+  std::sort(live.begin(), live.end());
+  return live;
+}
+
+bool SyncGroupManager::hasPlainNeighbours(Group &group) {
+  return group.last_plain_heard != time::steady_clock::TimePoint() &&
+         group.last_plain_heard + m_options.neighbour_lifetime >=
+             time::steady_clock::now();
+}
+
+SyncGroupManager::Group *SyncGroupManager::findProducer(const Name &sync_prefix,
+                                                        NodeID nid) {
+  auto it = m_sync_groups.find(sync_prefix);
+  if (it == m_sync_groups.end()) return nullptr;
+  for (Group *group : it->second) {
+    if (group->svs->getId() == nid) return group;
+  }
+  return nullptr;
+}
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "svs.hpp"
+
+namespace ndn {
+namespace svs {
+
+/**
+ * BatchTxClassConfig() - Transmit classes of a SyncGroupManager: as for SVS,
+ *  except that one flush may queue several batch interests, for different
+ *  neighbours, in the sync interest class.
+ */
+inline std::array<TxClassConfig, kTxClassCount> BatchTxClassConfig() {
+  auto config = DefaultTxClassConfig();
+  config[kTxSyncInterest] = {1500, 16, time::milliseconds(1000),
+                             DropPolicy::kDropHead};
+  return config;
+}
+
+struct SyncGroupManagerOptions {
+  // Every group's sync and data prefix must lie under this prefix, the only
+  // one registered with the forwarder
+  Name root_prefix = Name("/ndn/svs");
+  // Send the sync interests of groups with the same neighbours as one batch
+  // interest (see EncodeSyncBatch()). Only other SyncGroupManagers with the
+  // same root prefix understand batches; while a group hears sync interests
+  // from a node that sends none, its own go out unbatched as well.
+  bool batch_sync_interests = false;
+  // Neighbours not heard from within this long no longer count
+  time::milliseconds neighbour_lifetime = time::milliseconds(10000);
+  // Upper bound on the encoded entries of one batch interest; more entries
+  // go in further batches
+  size_t max_batch_size = 4096;
+  // Pacing and queues of batch interests and their replies, as
+  // SVSOptions::tx_rate, tx_burst and tx_classes are for one group
+  double tx_rate = 80;
+  double tx_burst = 4;
+  std::array<TxClassConfig, kTxClassCount> tx_classes = BatchTxClassConfig();
+};
+
+/**
+ * SyncGroupManager - Hosts many sync groups, possibly as several producers
+ *  of the same group, on one Face, one Scheduler and one KeyChain. A single
+ *  interest filter on the root prefix dispatches sync and data interests to
+ *  groups by prefix, and producers of the same group on this node hear each
+ *  other's sync interests directly. Not thread-safe; the SVS instances it
+ *  returns are as thread-safe as usual.
+ */
+class SyncGroupManager {
+ public:
+  using SyncUpdateCallback =
+      std::function<void(const std::vector<MissingDataInfo> &)>;
+  using DataInterestCallback = std::function<void(const Interest &)>;
+
+  // id tells this node's batch interests apart from those of other nodes
+  explicit SyncGroupManager(
+      NodeID id,
+      const SyncGroupManagerOptions &options = SyncGroupManagerOptions())
+      : SyncGroupManager(id, nullptr, options) {}
+
+  // Run on a face owned by the caller, e.g. a DummyClientFace
+  SyncGroupManager(
+      NodeID id, Face &face,
+      const SyncGroupManagerOptions &options = SyncGroupManagerOptions())
+      : SyncGroupManager(id, &face, options) {}
+
+  /**
+   * addGroup() - Join the group named by options.sync_prefix and
+   *  options.data_prefix as producer nid. Data interests under the data
+   *  prefix are passed to onDataInterest. Return nullptr if a prefix lies
+   *  outside the root prefix or nid already produces in the group. Call
+   *  before run() or on the event loop.
+   */
+  SVS *addGroup(NodeID nid, const SyncUpdateCallback &processSyncUpdate,
+                const SVSOptions &options = SVSOptions(),
+                const DataInterestCallback &onDataInterest = nullptr);
+
+  void registerPrefix();
+
+  void run();
+
+  void start();
+
+  Face &getFace() { return m_face; }
+
+  Scheduler &getScheduler() { return m_scheduler; }
+
+  KeyChain &getKeyChain() { return m_keyChain; }
+
+  size_t getGroupCount() const { return m_groups.size(); }
+
+ private:
+  using Neighbours = std::unordered_map<NodeID, time::steady_clock::TimePoint>;
+
+  struct Group {
+    std::unique_ptr<SVS> svs;
+    DataInterestCallback on_data_interest;
+    // Managers whose batches carried this group, by time last heard
+    Neighbours neighbours;
+    // Producers heard in those batches, by time last heard
+    Neighbours batched_producers;
+    // Last sync interest heard from a producer not sending batches
+    time::steady_clock::TimePoint last_plain_heard;
+  };
+
+  SyncGroupManager(NodeID id, Face *face,
+                   const SyncGroupManagerOptions &options);
+
+  void onInterest(const Interest &interest);
+
+  void onBatchInterest(const Interest &interest);
+
+  void onBatchAck(const Data &data);
+
+  void deliverSyncInterest(Group &group, const Name &n,
+                           const std::function<void(const Block &)> &ack_sink);
+
+  void onSyncInterestBuilt(Group &group, const Name &n);
+
+  void flushBatches();
+
+  void sendBatch(const SyncBatch &batch);
+
+  void enqueuePacket(TxClass tx_class, PacketPtr packet);
+
+  void scheduleTransmit();
+
+  void transmit();
+
+  std::vector<NodeID> liveNeighbours(Group &group);
+
+  bool hasPlainNeighbours(Group &group);
+
+  Group *findProducer(const Name &sync_prefix, NodeID nid);
+
+  const NodeID m_id;
+  const SyncGroupManagerOptions m_options;
+  // Group prefix of batch interest names, reserved
+  const Name m_batch_prefix;
+  std::unique_ptr<Face> m_owned_face;
+  Face &m_face;
+  KeyChain m_keyChain;
+  Scheduler m_scheduler;  // Shared by all groups
+  const security::SigningInfo m_signing_info =
+      security::SigningInfo(security::SigningInfo::SIGNER_TYPE_SHA256);
+
+  // Batch interests and replies queue and are paced here like the packets
+  // of a group
+  PacketPool m_packet_pool;
+  TokenBucket m_tx_bucket;
+  TxScheduler m_tx_queue;
+  scheduler::EventId m_tx_event;
+
+  std::vector<std::unique_ptr<Group>> m_groups;
+  // Groups by sync prefix and by data prefix, several per prefix when this
+  // node produces in a group more than once
+  std::unordered_map<Name, std::vector<Group *>> m_sync_groups;
+  std::unordered_map<Name, std::vector<Group *>> m_data_groups;
+
+  // Latest sync interest of each group built this event loop turn, waiting
+  // for flushBatches()
+  std::vector<std::pair<Group *, Name>> m_outgoing;
+  bool m_flush_posted = false;
+  bool m_started = false;
+};
+
+}  // namespace svs
+}  // namespace ndn
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 #include <ndn-cxx/face.hpp>
 #include <ndn-cxx/name.hpp>
 
 #include "svs_common.hpp"
+#include "svs_version_vector.hpp"
 
 namespace ndn {
 namespace svs {
@@ -54,27 +61,575 @@ inline std::pair<VersionVector, std::set<NodeID>> DecodeVVFromNameWithInterest(
   return std::make_pair(vv, interested_nodes);
 }
 
-inline Name MakeSyncNotifyName(const NodeID &nid, std::string encoded_vv,
+// TLV types of the binary state vector encoding. kTlvStateVector never
+// collides with the first byte of a string-encoded vector (an ASCII digit).
+static const uint8_t kTlvStateVector = 0xC9;
+static const uint8_t kTlvStateVectorEntry = 0xCA;
+
+/**
+ * AppendVarint() - Append a LEB128 varint: 7 bits per byte, least significant
+ *  group first, high bit set on every byte except the last.
+ */
+inline void AppendVarint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+/**
+ * ReadVarint() - Read a LEB128 varint at cur and advance cur past it. Return
+ *  false if the buffer ends early or the value overflows 64 bits.
+ */
+inline bool ReadVarint(const uint8_t *&cur, const uint8_t *end,
+                       uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && cur < end; shift += 7) {
+    uint8_t byte = *cur++;
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+/**
+ * EncodeVVToTlv() - Encode version vector in binary TLV format:
+ *  StateVectorEntry = 0xCA <length> <NodeID> <(seq << 1) | interested>
+ *                     [<snapshot seq>]
+ *  StateVector      = 0xC9 <length> *StateVectorEntry
+ * Lengths, NodeIDs and sequence numbers are varints. The snapshot seq,
+ *  given by snapshot_seq_ where non-zero, is the latest snapshot boundary
+ *  of the node. Decoders skip any bytes that follow the known fields of an
+ *  entry, so entries can be extended.
+ */
+inline std::string EncodeVVToTlv(
+    const VersionVector &v, std::function<bool(uint64_t)> is_important_data_,
+    std::function<uint64_t(NodeID)> snapshot_seq_ = nullptr) {
+  std::string entries;
+  entries.reserve(v.size() * 8);
+  std::string entry;
+  for (auto entry_vv : v) {
+    entry.clear();
+    AppendVarint(entry, entry_vv.first);
+    AppendVarint(entry, (entry_vv.second << 1) |
+                            (is_important_data_(entry_vv.first) ? 1 : 0));
+    uint64_t snapshot_seq = snapshot_seq_ ? snapshot_seq_(entry_vv.first) : 0;
+    if (snapshot_seq != 0) AppendVarint(entry, snapshot_seq);
+    entries.push_back(static_cast<char>(kTlvStateVectorEntry));
+    AppendVarint(entries, entry.size());
+    entries += entry;
+  }
+
+  std::string vv_encode;
+  vv_encode.reserve(entries.size() + 4);
+  vv_encode.push_back(static_cast<char>(kTlvStateVector));
+  AppendVarint(vv_encode, entries.size());
+  vv_encode += entries;
+  return vv_encode;
+}
+
+/**
+ * DecodeVVTlvWithSnapshots() - Decode a TLV-encoded state vector in a single
+ *  pass without allocating, calling visit(nid, seq, interested,
+ *  snapshot_seq) for every entry; snapshot_seq is 0 if the entry has none.
+ *  Return false if the buffer is malformed; entries before the error have
+ *  already been visited.
+ */
+template <typename Visitor>
+inline bool DecodeVVTlvWithSnapshots(const uint8_t *buf, size_t size,
+                                     Visitor &&visit) {
+  const uint8_t *cur = buf;
+  const uint8_t *end = buf + size;
+  uint64_t length;
+  if (cur == end || *cur++ != kTlvStateVector) return false;
+  if (!ReadVarint(cur, end, length) || length != static_cast<uint64_t>(end - cur))
+    return false;
+
+  while (cur < end) {
+    if (*cur++ != kTlvStateVectorEntry) return false;
+    if (!ReadVarint(cur, end, length) ||
+        length > static_cast<uint64_t>(end - cur))
+      return false;
+    const uint8_t *entry_end = cur + length;
+    uint64_t nid, seq_flag, snapshot_seq = 0;
+    if (!ReadVarint(cur, entry_end, nid) || !ReadVarint(cur, entry_end, seq_flag))
+      return false;
+    if (cur < entry_end && !ReadVarint(cur, entry_end, snapshot_seq))
+      return false;
+    visit(static_cast<NodeID>(nid), seq_flag >> 1, (seq_flag & 1) != 0,
+          snapshot_seq);
+    cur = entry_end;
+  }
+  return true;
+}
+
+/**
+ * DecodeVVTlv() - As DecodeVVTlvWithSnapshots(), calling visit(nid, seq,
+ *  interested).
+ */
+template <typename Visitor>
+inline bool DecodeVVTlv(const uint8_t *buf, size_t size, Visitor &&visit) {
+  return DecodeVVTlvWithSnapshots(
+      buf, size, [&](NodeID nid, uint64_t seq, bool interested, uint64_t) {
+        visit(nid, seq, interested);
+      });
+}
+
+/**
+ * DecodeSnapshotEntry() - Visitor body shared by the decoders below.
+ */
+inline void DecodeSnapshotEntry(NodeID nid, uint64_t seq, bool is_important,
+                                uint64_t snapshot_seq, VersionVector &vv,
+                                std::set<NodeID> &interested_nodes,
+                                SnapshotMap *snapshots) {
+  vv[nid] = seq;
+  if (is_important) interested_nodes.insert(nid);
+  if (snapshots && snapshot_seq != 0) (*snapshots)[nid] = snapshot_seq;
+}
+
+// TLV types of a delta state vector: the recently changed entries plus a
+// digest of the full vector
+static const uint8_t kTlvDeltaStateVector = 0xCB;
+static const uint8_t kTlvStateVectorDigest = 0xCC;
+
+/**
+ * DigestVV() - 64-bit digest of the non-zero entries of a version vector.
+ *  Entries at seq 0 are left out, so a node that only knows itself at 0
+ *  matches a node that has not heard of it yet.
+ */
+inline uint64_t DigestVV(const VersionVector &v) {
+  uint64_t digest = 0;
+  const auto &ids = v.ids();
+  const auto &seqs = v.seqs();
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (seqs[i] == 0) continue;
+    // splitmix64 finalizer over both fields, summed so the digest does not
+    // depend on entry order
+    uint64_t x = ids[i] * 0x9E3779B97F4A7C15ULL ^ seqs[i];
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    digest += x ^ (x >> 31);
+  }
+  return digest;
+}
+
+/**
+ * EncodeDeltaVVToTlv() - Encode the changed entries of a version vector and
+ *  the digest of the full one:
+ *  DeltaStateVector = 0xCB <length> StateVector StateVectorDigest
+ *  StateVectorDigest = 0xCC 0x08 <8-byte big-endian digest>
+ */
+inline std::string EncodeDeltaVVToTlv(
+    const VersionVector &changed, uint64_t digest,
+    std::function<bool(uint64_t)> is_important_data_,
+    std::function<uint64_t(NodeID)> snapshot_seq_ = nullptr) {
+  std::string inner = EncodeVVToTlv(changed, is_important_data_, snapshot_seq_);
+  inner.push_back(static_cast<char>(kTlvStateVectorDigest));
+  inner.push_back(8);
+  for (int shift = 56; shift >= 0; shift -= 8)
+    inner.push_back(static_cast<char>((digest >> shift) & 0xFF));
+
+  std::string vv_encode;
+  vv_encode.reserve(inner.size() + 4);
+  vv_encode.push_back(static_cast<char>(kTlvDeltaStateVector));
+  AppendVarint(vv_encode, inner.size());
+  vv_encode += inner;
+  return vv_encode;
+}
+
+inline bool IsDeltaVV(const uint8_t *buf, size_t size) {
+  return size > 0 && buf[0] == kTlvDeltaStateVector;
+}
+
+/**
+ * DecodeDeltaVV() - Decode a delta state vector into its changed entries and
+ *  the digest of the sender's full vector. Return false if the buffer is
+ *  malformed.
+ */
+inline bool DecodeDeltaVV(const uint8_t *buf, size_t size, VersionVector &vv,
+                          std::set<NodeID> &interested_nodes, uint64_t &digest,
+                          SnapshotMap *snapshots = nullptr) {
+  const uint8_t *cur = buf;
+  const uint8_t *end = buf + size;
+  uint64_t length;
+  if (cur == end || *cur++ != kTlvDeltaStateVector) return false;
+  if (!ReadVarint(cur, end, length) || length != static_cast<uint64_t>(end - cur))
+    return false;
+
+  // Inner StateVector
+  const uint8_t *vv_begin = cur;
+  if (cur == end || *cur++ != kTlvStateVector) return false;
+  if (!ReadVarint(cur, end, length) || length > static_cast<uint64_t>(end - cur))
+    return false;
+  cur += length;
+  if (!DecodeVVTlvWithSnapshots(
+          vv_begin, cur - vv_begin,
+          [&](NodeID nid, uint64_t seq, bool is_important,
+              uint64_t snapshot_seq) {
+            DecodeSnapshotEntry(nid, seq, is_important, snapshot_seq, vv,
+                                interested_nodes, snapshots);
+          }))
+    return false;
+
+  if (end - cur != 10 || cur[0] != kTlvStateVectorDigest || cur[1] != 8)
+    return false;
+  digest = 0;
+  for (cur += 2; cur < end; ++cur) digest = (digest << 8) | *cur;
+  return true;
+}
+
+/**
+ * EncodeVV() - Encode version vector in the given wire format.
+ */
+inline std::string EncodeVV(
+    const VersionVector &v, std::function<bool(uint64_t)> is_important_data_,
+    VVWireFormat format,
+    std::function<uint64_t(NodeID)> snapshot_seq_ = nullptr) {
+  // The string format has no room for snapshot boundaries
+  if (format == VVWireFormat::kTlv)
+    return EncodeVVToTlv(v, is_important_data_, snapshot_seq_);
+  return EncodeVVToNameWithInterest(v, is_important_data_);
+}
+
+/**
+ * DecodeVV() - Decode a full version vector in either wire format, telling
+ *  them apart by the first byte. Return false if the buffer is malformed or
+ *  holds a delta vector (see DecodeDeltaVV()).
+ */
+inline bool DecodeVV(const uint8_t *buf, size_t size, VersionVector &vv,
+                     std::set<NodeID> &interested_nodes,
+                     SnapshotMap *snapshots = nullptr) {
+  if (IsDeltaVV(buf, size)) return false;
+  if (size > 0 && buf[0] == kTlvStateVector) {
+    return DecodeVVTlvWithSnapshots(
+        buf, size,
+        [&](NodeID nid, uint64_t seq, bool is_important,
+            uint64_t snapshot_seq) {
+          DecodeSnapshotEntry(nid, seq, is_important, snapshot_seq, vv,
+                              interested_nodes, snapshots);
+        });
+  }
+
+  try {
+    std::tie(vv, interested_nodes) = DecodeVVFromNameWithInterest(
+        std::string(reinterpret_cast<const char *>(buf), size));
+  } catch (const std::logic_error &) {
+    // std::stoll throws invalid_argument / out_of_range on garbage
+    return false;
+  }
+  return true;
+}
+
+/**
+ * CoalesceMissingDataInfo() - Sort missing data ranges by NodeID and merge
+ *  overlapping or adjacent ranges of the same node, so every sequence
+ *  number appears at most once.
+ */
+inline void CoalesceMissingDataInfo(std::vector<MissingDataInfo> &updates) {
+  std::sort(updates.begin(), updates.end(),
+            [](const MissingDataInfo &a, const MissingDataInfo &b) {
+              return a.nodeID != b.nodeID ? a.nodeID < b.nodeID
+                                          : a.lowSeq < b.lowSeq;
+            });
+  size_t out = 0;
+  for (size_t i = 0; i < updates.size(); ++i) {
+    if (out > 0 && updates[out - 1].nodeID == updates[i].nodeID &&
+        updates[i].lowSeq <= updates[out - 1].highSeq + 1) {
+      updates[out - 1].highSeq =
+          std::max(updates[out - 1].highSeq, updates[i].highSeq);
+      updates[out - 1].snapshotSeq =
+          std::max(updates[out - 1].snapshotSeq, updates[i].snapshotSeq);
+      updates[out - 1].forRelay =
+          updates[out - 1].forRelay && updates[i].forRelay;
+    } else {
+      updates[out++] = updates[i];
+    }
+  }
+  updates.resize(out);
+}
+
+inline Name MakeSyncNotifyName(const Name &prefix, const NodeID &nid,
+                               const std::string &encoded_vv,
                                int64_t timestamp) {
   // name = /[syncNotify_prefix]/[nid]/[state-vector]/[heartbeat-vector]
-  Name n(kSyncNotifyPrefix);
-  n.appendNumber(nid).append(encoded_vv).appendNumber(timestamp);
+  Name n(prefix);
+  n.appendNumber(nid)
+      .append(reinterpret_cast<const uint8_t *>(encoded_vv.data()),
+              encoded_vv.size())
+      .appendNumber(timestamp);
   return n;
 }
 
+inline Name MakeSyncNotifyName(const NodeID &nid, const std::string &encoded_vv,
+                               int64_t timestamp) {
+  return MakeSyncNotifyName(kSyncNotifyPrefix, nid, encoded_vv, timestamp);
+}
+
 //TODO: should be part of application
-inline Name MakeDataName(const NodeID &nid, uint64_t seq) {
+inline Name MakeDataName(const Name &prefix, const NodeID &nid, uint64_t seq) {
   // name = /[vsyncData_prefix]/[node_id]/[seq]/%0
-  Name n(kSyncDataPrefix);
+  Name n(prefix);
   n.appendNumber(nid).appendNumber(seq).appendNumber(0);
   return n;
 }
 
+inline Name MakeDataName(const NodeID &nid, uint64_t seq) {
+  return MakeDataName(kSyncDataPrefix, nid, seq);
+}
+
+static const char kSnapshotComponent[] = "snapshot";
+
+// Application state of node nid covering its sequence numbers 1..seq
+inline Name MakeSnapshotName(const Name &prefix, const NodeID &nid,
+                             uint64_t seq) {
+  // name = /[vsyncData_prefix]/[node_id]/[seq]/snapshot
+  Name n(prefix);
+  n.appendNumber(nid).appendNumber(seq).append(
+      reinterpret_cast<const uint8_t *>(kSnapshotComponent),
+      sizeof(kSnapshotComponent) - 1);
+  return n;
+}
+
+inline Name MakeSnapshotName(const NodeID &nid, uint64_t seq) {
+  return MakeSnapshotName(kSyncDataPrefix, nid, seq);
+}
+
+// Sequence numbers low..high of node nid, fetched as the segments of one
+// stream of their concatenated Data packets (see RangeServer)
+inline Name MakeRangeName(const Name &prefix, const NodeID &nid, uint64_t low,
+                          uint64_t high) {
+  // name = /[vsyncData_prefix]/[node_id]/[low]-[high]
+  std::string range = std::to_string(low) + "-" + std::to_string(high);
+  Name n(prefix);
+  n.appendNumber(nid).append(reinterpret_cast<const uint8_t *>(range.data()),
+                             range.size());
+  return n;
+}
+
+inline Name MakeRangeSegmentName(const Name &prefix, const NodeID &nid,
+                                 uint64_t low, uint64_t high,
+                                 uint64_t segment) {
+  // name = /[vsyncData_prefix]/[node_id]/[low]-[high]/[segment]
+  return MakeRangeName(prefix, nid, low, high).appendSegment(segment);
+}
+
+/**
+ * ExtractRange() - Parse the range of a name built by
+ *  MakeRangeSegmentName(). Return false if n is no such name.
+ */
+inline bool ExtractRange(const Name &n, uint64_t &low, uint64_t &high) {
+  if (n.size() < 3 || !n.get(-1).isSegment()) return false;
+  const auto &range = n.get(-2);
+  const uint8_t *cur = range.value();
+  const uint8_t *end = cur + range.value_size();
+  uint64_t *bound = &low;
+  size_t digits = 0;
+  low = high = 0;
+  for (; cur != end; ++cur) {
+    if (*cur == '-' && bound == &low && digits > 0) {
+      bound = &high;
+      digits = 0;
+    } else if (*cur >= '0' && *cur <= '9' && digits < 19) {
+      *bound = *bound * 10 + (*cur - '0');
+      ++digits;
+    } else {
+      return false;
+    }
+  }
+  return bound == &high && digits > 0 && low <= high;
+}
+
+inline bool IsRangeName(const Name &n) {
+  uint64_t low, high;
+  return ExtractRange(n, low, high);
+}
+
+// Group prefix of a sync interest or data name built by the functions above
+inline Name ExtractGroupPrefix(const Name &n) { return n.getPrefix(-3); }
+
+inline bool IsSnapshotName(const Name &n) {
+  const auto &last = n.get(-1);
+  return last.value_size() == sizeof(kSnapshotComponent) - 1 &&
+         std::equal(last.value(), last.value() + last.value_size(),
+                    reinterpret_cast<const uint8_t *>(kSnapshotComponent));
+}
+
 inline uint64_t ExtractNodeID(const Name &n) { return n.get(-3).toNumber(); }
 
 inline std::string ExtractEncodedVV(const Name &n) { return n.get(-2).toUri(); }
 
+// Raw state vector component, for decoding without an intermediate string
+inline const name::Component &ExtractEncodedVVComponent(const Name &n) {
+  return n.get(-2);
+}
+
 inline uint64_t ExtractSequence(const Name &n) { return n.get(-2).toNumber(); }
 
+/**
+ * Bundle - Consecutive application payloads published as one Data under one
+ *  sequence number, flagged by kContentTypeBundle:
+ *
+ *  Content = VARINT(count) count*VARINT(payload size) *payload
+ *
+ *  The sizes form the index: payload i starts after payloads 0..i-1.
+ */
+static const uint32_t kContentTypeBundle = 1024;
+
+inline size_t VarintSize(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+inline std::string EncodeBundle(const std::vector<std::string> &payloads,
+                                size_t begin, size_t end) {
+  size_t size = VarintSize(end - begin);
+  for (size_t i = begin; i < end; ++i)
+    size += VarintSize(payloads[i].size()) + payloads[i].size();
+
+  std::string out;
+  out.reserve(size);
+  AppendVarint(out, end - begin);
+  for (size_t i = begin; i < end; ++i) AppendVarint(out, payloads[i].size());
+  for (size_t i = begin; i < end; ++i) out += payloads[i];
+  return out;
+}
+
+/**
+ * PackBundles() - Split payloads, in order, into as few bundles of at most
+ *  max_size bytes as possible. A payload too large for any bundle gets one
+ *  of its own.
+ */
+inline std::vector<std::string> PackBundles(
+    const std::vector<std::string> &payloads, size_t max_size) {
+  std::vector<std::string> bundles;
+  size_t begin = 0;
+  // Encoded size of the entries from begin on, without the count
+  size_t entries = 0;
+  for (size_t i = 0; i < payloads.size(); ++i) {
+    size_t entry = VarintSize(payloads[i].size()) + payloads[i].size();
+    if (i > begin &&
+        VarintSize(i - begin + 1) + entries + entry > max_size) {
+      bundles.push_back(EncodeBundle(payloads, begin, i));
+      begin = i;
+      entries = 0;
+    }
+    entries += entry;
+  }
+  if (begin < payloads.size())
+    bundles.push_back(EncodeBundle(payloads, begin, payloads.size()));
+  return bundles;
+}
+
+inline bool DecodeBundle(const uint8_t *buf, size_t size,
+                         std::vector<std::string> &payloads) {
+  const uint8_t *cur = buf;
+  const uint8_t *end = buf + size;
+  uint64_t count;
+  // Every payload takes at least its one byte size
+  if (!ReadVarint(cur, end, count) ||
+      count > static_cast<uint64_t>(end - cur))
+    return false;
+
+  std::vector<uint64_t> sizes(count);
+  for (auto &payload_size : sizes) {
+    if (!ReadVarint(cur, end, payload_size)) return false;
+  }
+  payloads.reserve(payloads.size() + count);
+  for (uint64_t payload_size : sizes) {
+    if (payload_size > static_cast<uint64_t>(end - cur)) return false;
+    payloads.emplace_back(reinterpret_cast<const char *>(cur), payload_size);
+    cur += payload_size;
+  }
+  return cur == end;
+}
+
+inline bool IsBundle(const Data &data) {
+  return data.getContentType() == kContentTypeBundle;
+}
+
+/**
+ * Sync batch - Sync interests of several groups sent as one interest, and
+ *  the ACKs answering it, by SyncGroupManager:
+ *
+ *  SyncBatch = 0xCE TLV-LENGTH *Entry
+ *  Entry     = VARINT(name size) Name VARINT(payload size) payload
+ *
+ *  In a batch interest each entry is a group's sync interest name with an
+ *  empty payload; in the reply, the name of an entry answered and the
+ *  encoded vector of the ACK.
+ */
+static const uint8_t kTlvSyncBatch = 0xCE;
+static const char kSyncBatchComponent[] = "batch";
+
+using SyncBatch = std::vector<std::pair<Name, std::string>>;
+
+inline std::string EncodeSyncBatch(const SyncBatch &batch) {
+  std::string entries;
+  for (const auto &entry : batch) {
+    const Block &wire = entry.first.wireEncode();
+    AppendVarint(entries, wire.size());
+    entries.append(reinterpret_cast<const char *>(wire.wire()), wire.size());
+    AppendVarint(entries, entry.second.size());
+    entries += entry.second;
+  }
+
+  std::string out;
+  out.reserve(entries.size() + 10);
+  out.push_back(static_cast<char>(kTlvSyncBatch));
+  AppendVarint(out, entries.size());
+  out += entries;
+  return out;
+}
+
+inline bool DecodeSyncBatch(const uint8_t *buf, size_t size, SyncBatch &batch) {
+  const uint8_t *cur = buf;
+  const uint8_t *end = buf + size;
+  uint64_t length;
+  if (cur == end || *cur++ != kTlvSyncBatch) return false;
+  if (!ReadVarint(cur, end, length) || length != static_cast<uint64_t>(end - cur))
+    return false;
+
+  while (cur != end) {
+    uint64_t name_size, payload_size;
+    if (!ReadVarint(cur, end, name_size) ||
+        name_size > static_cast<uint64_t>(end - cur))
+      return false;
+    Name name;
+    try {
+      name = Name(Block(cur, name_size));
+    } catch (const tlv::Error &) {
+      return false;
+    }
+    cur += name_size;
+    if (!ReadVarint(cur, end, payload_size) ||
+        payload_size > static_cast<uint64_t>(end - cur))
+      return false;
+    batch.emplace_back(std::move(name),
+                       std::string(reinterpret_cast<const char *>(cur),
+                                   payload_size));
+    cur += payload_size;
+  }
+  return true;
+}
+
+inline Name MakeSyncBatchName(const Name &root, NodeID manager,
+                              const std::string &encoded_batch,
+                              int64_t timestamp) {
+  // name = /[root]/batch/[manager]/[sync-batch]/[timestamp]
+  Name n(root);
+  n.append(reinterpret_cast<const uint8_t *>(kSyncBatchComponent),
+           sizeof(kSyncBatchComponent) - 1)
+      .appendNumber(manager)
+      .append(reinterpret_cast<const uint8_t *>(encoded_batch.data()),
+              encoded_batch.size())
+      .appendNumber(timestamp);
+  return n;
+}
+
 }  // namespace svs
 }  // namespace ndn
\ No newline at end of file
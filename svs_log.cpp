@@ -0,0 +1,203 @@
+#include "svs_log.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <set>
+
+#include "svs_helper.hpp"
+
+namespace ndn {
+namespace svs {
+
+static const char kLogMagic[8] = {'S', 'V', 'S', 'L', 'O', 'G', '1', '\0'};
+static const size_t kHeaderSize = 64;
+static const size_t kRecordHeaderSize = 16;
+static const size_t kGrowStep = 1 << 20;
+
+static size_t Align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+/**
+ * WriteSynced() - Replace the file at path with content and fsync it, so a
+ *  rename over another file never exposes it empty or torn.
+ */
+static bool WriteSynced(const std::string &path, const std::string &content) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+  size_t written = 0;
+  while (written < content.size()) {
+    ssize_t n = ::write(fd, content.data() + written, content.size() - written);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      ::close(fd);
+      return false;
+    }
+    written += n;
+  }
+  bool synced = fsync(fd) == 0;
+  return ::close(fd) == 0 && synced;
+}
+
+PersistentLog::~PersistentLog() {
+  if (m_map) {
+    msync(m_map, m_file_size, MS_SYNC);
+    munmap(m_map, m_max_size);
+  }
+  if (m_fd >= 0) ::close(m_fd);
+}
+
+bool PersistentLog::open(const std::string &directory, size_t max_size) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_map) return false;
+
+  if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) return false;
+  m_directory = directory;
+  m_max_size = std::max(max_size, kGrowStep);
+
+  m_fd = ::open((directory + "/data.log").c_str(), O_RDWR | O_CREAT, 0644);
+  if (m_fd < 0) return false;
+  struct stat st;
+  if (fstat(m_fd, &st) != 0) return false;
+  m_file_size = st.st_size;
+
+  bool created = m_file_size == 0;
+  if (created) {
+    if (ftruncate(m_fd, kGrowStep) != 0) return false;
+    m_file_size = kGrowStep;
+  }
+  if (m_file_size < kHeaderSize || m_file_size > m_max_size) return false;
+
+  void *map =
+      mmap(nullptr, m_max_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (map == MAP_FAILED) return false;
+  m_map = static_cast<uint8_t *>(map);
+
+  if (created) {
+    std::memcpy(m_map, kLogMagic, sizeof(kLogMagic));
+  } else if (std::memcmp(m_map, kLogMagic, sizeof(kLogMagic)) != 0) {
+    munmap(m_map, m_max_size);
+    m_map = nullptr;
+    return false;
+  }
+
+  // Rebuild the index, stopping at the first incomplete record
+  size_t offset = kHeaderSize;
+  while (offset + kRecordHeaderSize <= m_file_size) {
+    uint32_t size;
+    uint64_t seq;
+    std::memcpy(&size, m_map + offset, sizeof(size));
+    std::memcpy(&seq, m_map + offset + 8, sizeof(seq));
+    size_t next = offset + kRecordHeaderSize + Align8(size);
+    if (size == 0 || next > m_file_size || seq <= m_last_seq) break;
+    m_index[seq] = offset;
+    m_last_seq = seq;
+    offset = next;
+  }
+  m_end = offset;
+  return true;
+}
+
+bool PersistentLog::grow(size_t needed) {
+  if (needed <= m_file_size) return true;
+  if (needed > m_max_size) return false;
+  size_t size = std::min(std::max(m_file_size * 2, Align8(needed)), m_max_size);
+  if (ftruncate(m_fd, size) != 0) return false;
+  m_file_size = size;
+  return true;
+}
+
+uint64_t &PersistentLog::highSeq() const {
+  return *reinterpret_cast<uint64_t *>(m_map + sizeof(kLogMagic));
+}
+
+bool PersistentLog::append(uint64_t seq, const Data &data) {
+  const Block &wire = data.wireEncode();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_map || seq <= m_last_seq || wire.size() > UINT32_MAX) return false;
+
+  size_t record_size = kRecordHeaderSize + Align8(wire.size());
+  if (!grow(m_end + record_size)) return false;
+
+  uint8_t *record = m_map + m_end;
+  std::memcpy(record + 8, &seq, sizeof(seq));
+  std::memcpy(record + kRecordHeaderSize, wire.wire(), wire.size());
+  // Size last: a crash before this leaves a record reopening ignores
+  uint32_t size = static_cast<uint32_t>(wire.size());
+  std::memcpy(record, &size, sizeof(size));
+
+  m_index[seq] = m_end;
+  m_end += record_size;
+  m_last_seq = seq;
+  highSeq() = std::max(highSeq(), seq);
+  return true;
+}
+
+std::pair<const uint8_t *, size_t> PersistentLog::find(uint64_t seq) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_index.find(seq);
+  if (it == m_index.end()) return std::make_pair(nullptr, 0);
+  uint32_t size;
+  std::memcpy(&size, m_map + it->second, sizeof(size));
+  return std::make_pair(m_map + it->second + kRecordHeaderSize, size);
+}
+
+std::shared_ptr<const Data> PersistentLog::getData(uint64_t seq) const {
+  auto wire = find(seq);
+  if (!wire.first) return nullptr;
+  // Block keeps its own buffer; this is the only copy
+  return std::make_shared<Data>(Block(wire.first, wire.second));
+}
+
+void PersistentLog::noteSeq(uint64_t seq) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_map) return;
+  highSeq() = std::max(highSeq(), seq);
+}
+
+uint64_t PersistentLog::getLastSeq() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_map) return 0;
+  return std::max(highSeq(), m_last_seq);
+}
+
+bool PersistentLog::saveVector(const VersionVector &vv) {
+  std::string encoded = EncodeVVToTlv(vv, [](uint64_t) { return true; });
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_map) return false;
+
+  // The checkpoint must never get ahead of the log it summarizes
+  if (msync(m_map, m_file_size, MS_SYNC) != 0) return false;
+
+  std::string path = m_directory + "/vector.ckpt";
+  std::string tmp = path + ".tmp";
+  if (!WriteSynced(tmp, encoded)) return false;
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) return false;
+
+  // Make the rename itself durable
+  int dir_fd = ::open(m_directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd < 0) return false;
+  bool synced = fsync(dir_fd) == 0;
+  ::close(dir_fd);
+  return synced;
+}
+
+bool PersistentLog::loadVector(VersionVector &vv) const {
+  std::ifstream in(m_directory + "/vector.ckpt", std::ios::binary);
+  if (!in) return false;
+  std::string encoded((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+  std::set<NodeID> interested_nodes;
+  return DecodeVV(reinterpret_cast<const uint8_t *>(encoded.data()),
+                  encoded.size(), vv, interested_nodes);
+}
+
+}  // namespace svs
+}  // namespace ndn
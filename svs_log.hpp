@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ndn-cxx/data.hpp>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "svs_common.hpp"
+#include "svs_version_vector.hpp"
+
+namespace ndn {
+namespace svs {
+
+/**
+ * PersistentLog - Append-only, memory-mapped log of the Data this node
+ *  published, plus a checkpoint of its state vector, kept in a directory:
+ *
+ *  data.log    = Header *Record
+ *  Header      = "SVSLOG1\0" <highest own seq handed out> <48 zero bytes>
+ *  Record      = <u32 wire size> <u32 zero> <u64 seq> <Data wire> <pad to 8>
+ *  vector.ckpt = TLV state vector, replaced atomically
+ *
+ *  Integers are host byte order. The whole file is mapped once at its
+ *  maximum size and grown with ftruncate, so views returned by find() stay
+ *  valid until the log is closed. A record's size is written last; reopening
+ *  drops a torn record at the tail. Thread-safe.
+ */
+class PersistentLog {
+ public:
+  PersistentLog() = default;
+  ~PersistentLog();
+
+  PersistentLog(const PersistentLog &) = delete;
+  PersistentLog &operator=(const PersistentLog &) = delete;
+
+  /**
+   * open() - Open or create the log in directory, mapping up to max_size
+   *  bytes of data. Return false on any I/O error or foreign file.
+   */
+  bool open(const std::string &directory,
+            size_t max_size = size_t(64) << 20);
+
+  /**
+   * append() - Log the signed wire encoding of data as seq, which must be
+   *  higher than every logged seq. Return false if it is not or the log is
+   *  full.
+   */
+  bool append(uint64_t seq, const Data &data);
+
+  /**
+   * find() - Wire encoding of the Data logged as seq, pointing into the
+   *  mapping, or {nullptr, 0}.
+   */
+  std::pair<const uint8_t *, size_t> find(uint64_t seq) const;
+
+  /**
+   * getData() - Decode the Data logged as seq, or return nullptr. Its
+   *  signature is the original one.
+   */
+  std::shared_ptr<const Data> getData(uint64_t seq) const;
+
+  /**
+   * noteSeq() - Record that seq was handed out, logged or not, so it is not
+   *  handed out again after a restart. A store into the mapped header.
+   */
+  void noteSeq(uint64_t seq);
+
+  /**
+   * getLastSeq() - Highest seq logged or noted.
+   */
+  uint64_t getLastSeq() const;
+
+  /**
+   * saveVector() - Replace the state vector checkpoint and flush the data
+   *  log to disk.
+   */
+  bool saveVector(const VersionVector &vv);
+
+  /**
+   * loadVector() - Read the checkpoint into vv. Return false if there is
+   *  none or it does not decode.
+   */
+  bool loadVector(VersionVector &vv) const;
+
+ private:
+  bool grow(size_t needed);
+
+  uint64_t &highSeq() const;
+
+  mutable std::mutex m_mutex;
+  std::string m_directory;
+  int m_fd = -1;
+  uint8_t *m_map = nullptr;
+  size_t m_max_size = 0;
+  size_t m_file_size = 0;
+  // Offset where the next record goes
+  size_t m_end = 0;
+  uint64_t m_last_seq = 0;
+  // Record offset by seq
+  std::unordered_map<uint64_t, size_t> m_index;
+};
+
+}  // namespace svs
+}  // namespace ndn
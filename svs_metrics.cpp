@@ -0,0 +1,145 @@
+#include "svs_metrics.hpp"
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace ndn {
+namespace svs {
+
+void Histogram::record(time::nanoseconds duration) {
+  int64_t ns = std::max<int64_t>(duration.count(), 0);
+  size_t bucket = 0;
+  for (uint64_t v = ns; v != 0 && bucket < kBuckets - 1; v >>= 1) ++bucket;
+
+  m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum_ns.fetch_add(ns, std::memory_order_relaxed);
+  int64_t max = m_max_ns.load(std::memory_order_relaxed);
+  while (ns > max && !m_max_ns.compare_exchange_weak(
+                         max, ns, std::memory_order_relaxed)) {
+  }
+}
+
+time::nanoseconds Histogram::getPercentile(double q) const {
+  uint64_t count = getCount();
+  if (count == 0) return time::nanoseconds(0);
+
+  uint64_t rank = static_cast<uint64_t>(q * count);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += getBucket(i);
+    if (seen > rank) {
+      if (i == 0) return time::nanoseconds(0);
+      uint64_t bound = (uint64_t(1) << i) - 1;
+      return std::min(getMax(), time::nanoseconds(static_cast<int64_t>(
+                                    std::min<uint64_t>(bound, INT64_MAX))));
+    }
+  }
+  return getMax();
+}
+
+static void DumpHistogram(std::ostream &os, const Histogram &histogram) {
+  os << "{\"count\": " << histogram.getCount()
+     << ", \"sum_ns\": " << histogram.getSum().count()
+     << ", \"max_ns\": " << histogram.getMax().count()
+     << ", \"p50_ns\": " << histogram.getPercentile(0.5).count()
+     << ", \"p99_ns\": " << histogram.getPercentile(0.99).count() << "}";
+}
+
+void SVSMetrics::dump(std::ostream &os) const {
+  static const char *const kClassNames[kTxClassCount] = {
+      "ack", "sync_interest", "data_reply", "data_interest_forwarded",
+      "data_interest", "packet"};
+
+  os << "{\"sync_interests_sent\": " << sync_interests_sent.get()
+     << ", \"sync_interests_suppressed\": " << sync_interests_suppressed.get()
+     << ", \"acks_sent_immediate\": " << acks_sent_immediate.get()
+     << ", \"acks_sent_delayed\": " << acks_sent_delayed.get()
+     << ", \"acks_suppressed\": " << acks_suppressed.get()
+     << ", \"nacks\": " << nacks.get() << ", \"timeouts\": " << timeouts.get()
+     << ", \"merges_changed_state\": " << merges_changed_state.get()
+     << ", \"vector_size\": " << vector_size.get() << ", \"queue_depth\": {";
+  for (size_t i = 0; i < kTxClassCount; ++i) {
+    os << (i ? ", " : "") << "\"" << kClassNames[i]
+       << "\": " << queue_depth[i].get();
+  }
+  os << "}, \"queue_dropped\": {";
+  for (size_t i = 0; i < kTxClassCount; ++i) {
+    os << (i ? ", " : "") << "\"" << kClassNames[i]
+       << "\": " << queue_dropped[i].get();
+  }
+  os << "}, \"queue_wait\": ";
+  DumpHistogram(os, queue_wait);
+  os << ", \"update_latency\": ";
+  DumpHistogram(os, update_latency);
+  os << "}\n";
+}
+
+bool DumpMetrics(const SVSMetrics &metrics, const std::string &target) {
+  static const std::string kUnixPrefix = "unix:";
+
+  if (target.compare(0, kUnixPrefix.size(), kUnixPrefix) == 0) {
+    using boost::asio::local::datagram_protocol;
+    std::ostringstream os;
+    metrics.dump(os);
+    std::string json = os.str();
+
+    boost::asio::io_service io;
+    datagram_protocol::socket socket(io);
+    boost::system::error_code ec;
+    socket.open(datagram_protocol(), ec);
+    if (ec) return false;
+    socket.non_blocking(true, ec);
+    if (ec) return false;
+    socket.send_to(boost::asio::buffer(json),
+                   datagram_protocol::endpoint(
+                       target.substr(kUnixPrefix.size())),
+                   0, ec);
+    return !ec;
+  }
+
+  // Write to a temporary file and rename, so readers never see a partial
+  // dump
+  std::string tmp = target + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    if (!out) return false;
+    metrics.dump(out);
+    if (!out) return false;
+  }
+  return std::rename(tmp.c_str(), target.c_str()) == 0;
+}
+
+MetricsDumper::MetricsDumper(const SVSMetrics &metrics,
+                             const std::string &target,
+                             time::milliseconds period)
+    : m_metrics(metrics),
+      m_target(target),
+      m_period(period),
+      m_thread([this] { run(); }) {}
+
+MetricsDumper::~MetricsDumper() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_one();
+  m_thread.join();
+}
+
+void MetricsDumper::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_cv.wait_for(lock, m_period, [this] { return m_stop; })) {
+    lock.unlock();
+    if (!DumpMetrics(m_metrics, m_target))
+      std::cerr << "Failed to dump metrics to " << m_target << std::endl;
+    lock.lock();
+  }
+}
+
+}  // namespace svs
+}  // namespace ndn
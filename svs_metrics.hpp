@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "svs_common.hpp"
+
+namespace ndn {
+namespace svs {
+
+// Metrics are updated with relaxed atomics only: no locks, and readers on
+// other threads see each value individually up to date, not a consistent
+// snapshot across values.
+
+class Counter {
+ public:
+  void increment(uint64_t n = 1) {
+    m_value.fetch_add(n, std::memory_order_relaxed);
+  }
+  uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> m_value{0};
+};
+
+class Gauge {
+ public:
+  void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+  int64_t get() const { return m_value.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> m_value{0};
+};
+
+/**
+ * Histogram - Distribution of durations in power-of-two nanosecond buckets:
+ *  bucket i counts samples in [2^(i-1), 2^i) ns, bucket 0 counts zero.
+ */
+class Histogram {
+ public:
+  static const size_t kBuckets = 64;
+
+  Histogram() {
+    for (auto &bucket : m_buckets) bucket.store(0, std::memory_order_relaxed);
+  }
+
+  void record(time::nanoseconds duration);
+
+  uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+  time::nanoseconds getSum() const {
+    return time::nanoseconds(m_sum_ns.load(std::memory_order_relaxed));
+  }
+  time::nanoseconds getMax() const {
+    return time::nanoseconds(m_max_ns.load(std::memory_order_relaxed));
+  }
+  uint64_t getBucket(size_t i) const {
+    return m_buckets[i].load(std::memory_order_relaxed);
+  }
+
+  /**
+   * getPercentile() - Upper bound of the bucket holding quantile q (0..1).
+   */
+  time::nanoseconds getPercentile(double q) const;
+
+ private:
+  std::atomic<uint64_t> m_buckets[kBuckets];
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<int64_t> m_sum_ns{0};
+  std::atomic<int64_t> m_max_ns{0};
+};
+
+/**
+ * SVSMetrics - Counters, gauges and histograms of one SVS instance.
+ */
+struct SVSMetrics {
+  Counter sync_interests_sent;
+  // Periodic sync interests postponed because an identical vector was heard
+  Counter sync_interests_suppressed;
+  Counter acks_sent_immediate;
+  Counter acks_sent_delayed;
+  // Delayed ACKs cancelled as redundant or merged into a later one
+  Counter acks_suppressed;
+  Counter nacks;
+  Counter timeouts;
+  Counter merges_changed_state;
+
+  Gauge queue_depth[kTxClassCount];
+  // Packets dropped per class so far, see TxScheduler::getDropped()
+  Gauge queue_dropped[kTxClassCount];
+  Gauge vector_size;
+
+  // Time packets wait in the transmit queues
+  Histogram queue_wait;
+  // From a remote node sending the sync interest that announces its update
+  // to the local processSyncUpdate call. Assumes loosely synchronized
+  // clocks.
+  Histogram update_latency;
+
+  /**
+   * dump() - Write all metrics as one JSON object.
+   */
+  void dump(std::ostream &os) const;
+};
+
+/**
+ * DumpMetrics() - Write metrics as JSON to target: a file path (replaced on
+ *  every dump), or "unix:<path>" to send one datagram to a local socket.
+ *  Return false if the target could not be written. A file dump writes,
+ *  flushes and renames, so it may block on the disk; the socket send never
+ *  blocks and fails instead if the receiver's buffer is full.
+ */
+bool DumpMetrics(const SVSMetrics &metrics, const std::string &target);
+
+/**
+ * MetricsDumper - Calls DumpMetrics() every period on a thread of its own,
+ *  keeping slow disks and sockets off the event loop. Stops, without a
+ *  final dump, when destroyed; metrics must outlive it.
+ */
+class MetricsDumper {
+ public:
+  MetricsDumper(const SVSMetrics &metrics, const std::string &target,
+                time::milliseconds period);
+
+  MetricsDumper(const MetricsDumper &) = delete;
+  MetricsDumper &operator=(const MetricsDumper &) = delete;
+
+  ~MetricsDumper();
+
+ private:
+  void run();
+
+  const SVSMetrics &m_metrics;
+  const std::string m_target;
+  const time::milliseconds m_period;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stop = false;
+  std::thread m_thread;
+};
+
+}  // namespace svs
+}  // namespace ndn
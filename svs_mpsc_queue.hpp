@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace ndn {
+namespace svs {
+
+/**
+ * MpscQueue - Bounded lock-free queue for many producer threads and a single
+ *  consumer thread. Every slot carries a sequence number telling producers
+ *  and the consumer whose turn it is (D. Vyukov's bounded queue), so push
+ *  and pop are a compare-and-swap and two atomic loads in the common case.
+ *  Capacity is rounded up to a power of two.
+ */
+template <typename T>
+class MpscQueue {
+ public:
+  explicit MpscQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    m_mask = size - 1;
+    m_cells.reset(new Cell[size]);
+    for (size_t i = 0; i < size; ++i)
+      m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    m_tail.value.store(0, std::memory_order_relaxed);
+    m_head.value = 0;
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  /**
+   * tryPush() - Append value. Return false if the queue is full. Safe to call
+   *  from any thread.
+   */
+  bool tryPush(T &&value) {
+    size_t pos = m_tail.value.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = m_cells[pos & m_mask];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (m_tail.value.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_tail.value.load(std::memory_order_relaxed);
+      }
+    }
+
+    Cell &cell = m_cells[pos & m_mask];
+    cell.value = std::move(value);
+    cell.sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * tryPop() - Remove the oldest value into value. Return false if the queue
+   *  is empty or the oldest push has not completed yet. Consumer thread only.
+   */
+  bool tryPop(T &value) {
+    Cell &cell = m_cells[m_head.value & m_mask];
+    size_t seq = cell.sequence.load(std::memory_order_acquire);
+    if (seq != m_head.value + 1) return false;
+
+    value = std::move(cell.value);
+    cell.value = T();
+    cell.sequence.store(m_head.value + m_mask + 1, std::memory_order_release);
+    ++m_head.value;
+    return true;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  // Keeps producers and consumer on different cache lines. Padding rather
+  // than alignas, so owners stay allocatable with plain C++14 new.
+  template <typename U>
+  struct Padded {
+    char pad[64];
+    U value;
+  };
+
+  std::unique_ptr<Cell[]> m_cells;
+  size_t m_mask;
+  Padded<std::atomic<size_t>> m_tail;
+  Padded<size_t> m_head;
+};
+
+}  // namespace svs
+}  // namespace ndn
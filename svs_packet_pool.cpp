@@ -0,0 +1,57 @@
+#include "svs_packet_pool.hpp"
+
+namespace ndn {
+namespace svs {
+
+PacketPtr PacketPool::acquire() {
+  Packet *packet;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_free) grow();
+    packet = m_free;
+    m_free = packet->next;
+    --m_stats.free;
+    ++m_stats.acquired;
+  }
+  packet->next = nullptr;
+  packet->pool = this;
+  return PacketPtr(packet);
+}
+
+void PacketPool::release(Packet *packet) {
+  // Outside the lock; keeps data shared with a data store from lingering
+  // in the free list
+  packet->interest = Interest();
+  packet->data.reset();
+  packet->local_data = Data();
+  packet->on_data = nullptr;
+  packet->on_nack = nullptr;
+  packet->on_timeout = nullptr;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  packet->next = m_free;
+  m_free = packet;
+  ++m_stats.free;
+}
+
+PacketPoolStats PacketPool::getStats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+/**
+ * grow() - Allocate another chunk onto the free list. Caller holds m_mutex.
+ */
+void PacketPool::grow() {
+  std::unique_ptr<Packet[]> chunk(new Packet[m_chunk_size]);
+  for (size_t i = 0; i < m_chunk_size; ++i) {
+    chunk[i].next = m_free;
+    m_free = &chunk[i];
+  }
+  m_chunks.push_back(std::move(chunk));
+  m_stats.allocated += m_chunk_size;
+  m_stats.free += m_chunk_size;
+}
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "svs_common.hpp"
+
+namespace ndn {
+namespace svs {
+
+/**
+ * PacketReleaser - Deleter of PacketPtr, handing the packet back to the
+ *  pool it came from.
+ */
+struct PacketReleaser {
+  void operator()(Packet *packet) const;
+};
+
+// A packet acquired from a PacketPool, returned to it when dropped
+using PacketPtr = std::unique_ptr<Packet, PacketReleaser>;
+
+struct PacketPoolStats {
+  uint64_t acquired = 0;
+  // Packets ever allocated, in chunks; the rest of acquired were reused
+  uint64_t allocated = 0;
+  size_t free = 0;
+};
+
+/**
+ * PacketPool - Free list of Packets, allocated chunk_size at a time and
+ *  never returned to the heap, so a node sending steadily stops allocating
+ *  packets once the pool covers its queues. Released packets drop their
+ *  Interest, Data and callbacks right away. Safe to call from any thread;
+ *  must outlive every packet acquired.
+ */
+class PacketPool {
+ public:
+  explicit PacketPool(size_t chunk_size = 64)
+      : m_chunk_size(chunk_size > 0 ? chunk_size : 1) {}
+
+  PacketPool(const PacketPool &) = delete;
+  PacketPool &operator=(const PacketPool &) = delete;
+
+  /**
+   * acquire() - Return a packet in its default state.
+   */
+  PacketPtr acquire();
+
+  /**
+   * release() - Reset packet and put it on the free list. Called by
+   *  PacketPtr.
+   */
+  void release(Packet *packet);
+
+  PacketPoolStats getStats() const;
+
+ private:
+  void grow();
+
+  const size_t m_chunk_size;
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<Packet[]>> m_chunks;
+  // Linked through Packet::next
+  Packet *m_free = nullptr;
+  PacketPoolStats m_stats;
+};
+
+inline void PacketReleaser::operator()(Packet *packet) const {
+  packet->pool->release(packet);
+}
+
+/**
+ * PacketQueue - FIFO of packets linked through Packet::next, owning them.
+ *  Pushing and popping never allocate. Not thread-safe.
+ */
+class PacketQueue {
+ public:
+  PacketQueue() = default;
+  PacketQueue(const PacketQueue &) = delete;
+  PacketQueue &operator=(const PacketQueue &) = delete;
+
+  ~PacketQueue() { clear(); }
+
+  bool empty() const { return m_head == nullptr; }
+
+  size_t size() const { return m_size; }
+
+  Packet &front() const { return *m_head; }
+
+  void push_back(PacketPtr packet) {
+    Packet *tail = packet.release();
+    tail->next = nullptr;
+    if (m_tail)
+      m_tail->next = tail;
+    else
+      m_head = tail;
+    m_tail = tail;
+    ++m_size;
+  }
+
+  PacketPtr pop_front() {
+    Packet *head = m_head;
+    m_head = head->next;
+    if (!m_head) m_tail = nullptr;
+    head->next = nullptr;
+    --m_size;
+    return PacketPtr(head);
+  }
+
+  void clear() {
+    while (!empty()) pop_front();
+  }
+
+ private:
+  Packet *m_head = nullptr;
+  Packet *m_tail = nullptr;
+  size_t m_size = 0;
+};
+
+}  // namespace svs
+}  // namespace ndn
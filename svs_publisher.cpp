@@ -0,0 +1,112 @@
+#include "svs_publisher.hpp"
+
+#include <iostream>
+
+namespace ndn {
+namespace svs {
+
+uint64_t BatchPublisher::publishBatch(
+    const std::vector<std::string> &payloads) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return publishLocked(payloads);
+}
+
+void BatchPublisher::publish(const std::string &payload) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_buffer.push_back(payload);
+
+  if (m_options.max_batch_size > 0 &&
+      m_buffer.size() >= m_options.max_batch_size) {
+    publishLocked(m_buffer);
+    m_buffer.clear();
+    ++m_buffer_generation;
+    return;
+  }
+
+  if (m_buffer.size() == 1 && m_options.max_delay > time::milliseconds(0)) {
+    // Scheduler is not thread-safe; arm the timer on its own event loop
+    uint64_t generation = m_buffer_generation;
+    m_face.getIoService().post([this, generation] {
+      m_scheduler.schedule(m_options.max_delay, [this, generation] {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (generation != m_buffer_generation || m_buffer.empty()) return;
+        publishLocked(m_buffer);
+        m_buffer.clear();
+        ++m_buffer_generation;
+      });
+    });
+  }
+}
+
+void BatchPublisher::flush() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_buffer.empty()) return;
+  publishLocked(m_buffer);
+  m_buffer.clear();
+  ++m_buffer_generation;
+}
+
+/**
+ * publishLocked() - Publish payloads as one batch, packed into bundles if
+ *  configured.
+ */
+uint64_t BatchPublisher::publishLocked(
+    const std::vector<std::string> &payloads) {
+  if (payloads.empty()) return 0;
+  if (m_options.max_bundle_size > 0)
+    return publishContents(PackBundles(payloads, m_options.max_bundle_size),
+                           true);
+  return publishContents(payloads, false);
+}
+
+/**
+ * publishContents() - Reserve one sequence range, sign and store a Data per
+ *  content, then announce the whole range with one doUpdate().
+ */
+uint64_t BatchPublisher::publishContents(
+    const std::vector<std::string> &contents, bool bundled) {
+  uint64_t first_seq = m_svs.reserveSeq(contents.size());
+  for (size_t i = 0; i < contents.size(); ++i) {
+    auto data = std::make_shared<Data>(
+        MakeDataName(m_svs.getDataPrefix(), m_svs.getId(), first_seq + i));
+    data->setContent(reinterpret_cast<const uint8_t *>(contents[i].data()),
+                     contents[i].size());
+    if (bundled) data->setContentType(kContentTypeBundle);
+    data->setFreshnessPeriod(m_options.freshness_period);
+    m_keyChain.sign(*data, m_signing_info);
+    PersistentLog *log = m_svs.getLog();
+    if (log && !log->append(first_seq + i, *data)) {
+      // Still served from memory, but lost on restart
+      std::cerr << "Failed to log data " << first_seq + i
+                << " (out of order or log full)" << std::endl;
+    }
+    m_store(data);
+  }
+
+  m_last_seq = first_seq + contents.size() - 1;
+  m_svs.doUpdate(m_last_seq);
+  return first_seq;
+}
+
+uint64_t BatchPublisher::publishSnapshot(const std::string &payload) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_buffer.empty()) {
+    publishLocked(m_buffer);
+    m_buffer.clear();
+    ++m_buffer_generation;
+  }
+  if (m_last_seq == 0) return 0;
+
+  auto data = std::make_shared<Data>(
+      MakeSnapshotName(m_svs.getDataPrefix(), m_svs.getId(), m_last_seq));
+  data->setContent(reinterpret_cast<const uint8_t *>(payload.data()),
+                   payload.size());
+  data->setFreshnessPeriod(m_options.freshness_period);
+  m_keyChain.sign(*data, m_signing_info);
+  m_store(data);
+  m_svs.setSnapshot(m_last_seq);
+  return m_last_seq;
+}
+
+}  // namespace svs
+}  // namespace ndn
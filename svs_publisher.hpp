@@ -0,0 +1,98 @@
+#pragma once
+
+#include <mutex>
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+#include <string>
+#include <vector>
+
+#include "svs.hpp"
+
+namespace ndn {
+namespace svs {
+
+struct BatchPublisherOptions {
+  // publish() flushes once this many payloads are buffered. Zero disables.
+  size_t max_batch_size = 64;
+  // publish() flushes this long after the first buffered payload. Zero
+  // disables.
+  time::milliseconds max_delay = time::milliseconds(50);
+  time::milliseconds freshness_period = time::milliseconds(1000);
+  // Pack the payloads of a batch into bundles of up to this many content
+  // bytes, each published as one Data under one sequence number (see
+  // PackBundles()). Consumers must unpack them with DecodeBundle(). Zero
+  // publishes one Data per payload.
+  size_t max_bundle_size = 0;
+};
+
+/**
+ * BatchPublisher - Publishes payloads as Data packets in batches. A batch of
+ *  N payloads takes a contiguous range of N sequence numbers, or one per
+ *  bundle with max_bundle_size, and is announced with a single state vector
+ *  increment, hence a single sync interest. Safe to use from any thread.
+ */
+class BatchPublisher {
+ public:
+  // Receives every signed Data before its batch is announced
+  using StoreCallback = std::function<void(std::shared_ptr<const Data>)>;
+
+  /**
+   * Timers of the auto-flush mode run on the event loop of face.
+   */
+  BatchPublisher(SVS &svs, Face &face, KeyChain &keyChain,
+                 const StoreCallback &store,
+                 const BatchPublisherOptions &options = BatchPublisherOptions())
+      : m_svs(svs),
+        m_face(face),
+        m_scheduler(face.getIoService()),
+        m_keyChain(keyChain),
+        m_store(store),
+        m_options(options) {}
+
+  /**
+   * publishBatch() - Publish payloads immediately as one batch. Return the
+   *  sequence number of the first payload, or of the first bundle.
+   */
+  uint64_t publishBatch(const std::vector<std::string> &payloads);
+
+  /**
+   * publish() - Buffer payload; the buffer is published as one batch when
+   *  max_batch_size or max_delay is reached, or on flush().
+   */
+  void publish(const std::string &payload);
+
+  void flush();
+
+  /**
+   * publishSnapshot() - Flush, then publish payload as the application state
+   *  covering everything published so far and advertise it, so nodes that
+   *  join later fetch it instead of the whole history. Return the last
+   *  sequence number it covers, or 0 if nothing was published yet.
+   */
+  uint64_t publishSnapshot(const std::string &payload);
+
+ private:
+  uint64_t publishLocked(const std::vector<std::string> &payloads);
+
+  uint64_t publishContents(const std::vector<std::string> &contents,
+                           bool bundled);
+
+  SVS &m_svs;
+  Face &m_face;
+  Scheduler m_scheduler;
+  KeyChain &m_keyChain;
+  const StoreCallback m_store;
+  const BatchPublisherOptions m_options;
+  const security::SigningInfo m_signing_info =
+      security::SigningInfo(security::SigningInfo::SIGNER_TYPE_SHA256);
+
+  std::mutex m_mutex;
+  std::vector<std::string> m_buffer;
+  // Bumped per flush so a stale flush timer does nothing
+  uint64_t m_buffer_generation = 0;
+  // Last sequence number published
+  uint64_t m_last_seq = 0;
+};
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,85 @@
+#include "svs_range_server.hpp"
+
+#include <algorithm>
+
+#include "svs_helper.hpp"
+
+namespace ndn {
+namespace svs {
+
+std::shared_ptr<const Data> RangeServer::getSegment(const Name &n,
+                                                    const Lookup &lookup) {
+  uint64_t low, high;
+  if (!ExtractRange(n, low, high)) return nullptr;
+  Name range_name = n.getPrefix(-1);
+  uint64_t segment = n.get(-1).toSegment();
+
+  auto now = time::steady_clock::now();
+  auto it = std::find_if(m_streams.begin(), m_streams.end(),
+                         [&](const Stream &stream) {
+                           return stream.name == range_name;
+                         });
+  if (it != m_streams.end() &&
+      it->built + m_options.freshness_period <= now) {
+    m_streams.erase(it);
+    it = m_streams.end();
+  }
+
+  if (it == m_streams.end()) {
+    Stream stream;
+    stream.name = range_name;
+    stream.built = now;
+    stream.segments =
+        buildSegments(range_name, ExtractNodeID(n), low, high, lookup);
+    if (stream.segments.empty()) return nullptr;
+    m_streams.push_front(std::move(stream));
+    if (m_streams.size() > m_options.max_streams) m_streams.pop_back();
+    it = m_streams.begin();
+  } else {
+    m_streams.splice(m_streams.begin(), m_streams, it);
+  }
+
+  if (segment >= it->segments.size()) return nullptr;
+  return it->segments[segment];
+}
+
+/**
+ * buildSegments() - Concatenate the Data held of nid in low..high, capped at
+ *  max_range sequence numbers, and sign it as segments of range_name. Empty
+ *  if none is held.
+ */
+std::vector<std::shared_ptr<const Data>> RangeServer::buildSegments(
+    const Name &range_name, NodeID nid, uint64_t low, uint64_t high,
+    const Lookup &lookup) {
+  std::vector<std::shared_ptr<const Data>> segments;
+  if (m_options.max_range > 0 && high - low >= m_options.max_range)
+    high = low + m_options.max_range - 1;
+
+  std::string stream;
+  for (uint64_t seq = low; seq <= high; ++seq) {
+    auto data = lookup(nid, seq);
+    if (!data) continue;
+    const Block &wire = data->wireEncode();
+    stream.append(reinterpret_cast<const char *>(wire.wire()), wire.size());
+  }
+  if (stream.empty()) return segments;
+
+  size_t segment_size = std::max<size_t>(m_options.segment_size, 1);
+  size_t count = (stream.size() + segment_size - 1) / segment_size;
+  segments.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto segment = std::make_shared<Data>(Name(range_name).appendSegment(i));
+    size_t offset = i * segment_size;
+    segment->setContent(
+        reinterpret_cast<const uint8_t *>(stream.data()) + offset,
+        std::min(segment_size, stream.size() - offset));
+    segment->setFinalBlock(name::Component::fromSegment(count - 1));
+    segment->setFreshnessPeriod(m_options.freshness_period);
+    m_keyChain.sign(*segment, m_signing_info);
+    segments.push_back(std::move(segment));
+  }
+  return segments;
+}
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+#include <vector>
+
+#include "svs_common.hpp"
+
+namespace ndn {
+namespace svs {
+
+struct RangeServerOptions {
+  // Content bytes per segment
+  size_t segment_size = 4000;
+  // Longer ranges are answered up to this many sequence numbers from low
+  size_t max_range = 256;
+  // Streams kept for the interests of their remaining segments
+  size_t max_streams = 16;
+  // Also how long a stream is reused before being rebuilt
+  time::milliseconds freshness_period = time::milliseconds(1000);
+};
+
+/**
+ * RangeServer - Answers range interests (see MakeRangeSegmentName()) from
+ *  Data packets looked up one sequence number at a time. The wire encodings
+ *  of those held are concatenated in sequence order and cut into segments,
+ *  built on the first interest for a range and kept for the others. Any
+ *  node holding data of a producer can serve its ranges; consumers fetch
+ *  what a stream lacks one name at a time. Not thread-safe.
+ */
+class RangeServer {
+ public:
+  // Data of (nid, seq) held locally, or nullptr
+  using Lookup = std::function<std::shared_ptr<const Data>(NodeID, uint64_t)>;
+
+  explicit RangeServer(KeyChain &keyChain,
+                       const RangeServerOptions &options = RangeServerOptions())
+      : m_keyChain(keyChain), m_options(options) {}
+
+  /**
+   * getSegment() - Return the segment named by the range interest name n,
+   *  building its stream with lookup if needed. Return nullptr if n is no
+   *  range name, no Data of the range is held, or the segment is past the
+   *  end.
+   */
+  std::shared_ptr<const Data> getSegment(const Name &n, const Lookup &lookup);
+
+ private:
+  struct Stream {
+    Name name;
+    time::steady_clock::TimePoint built;
+    std::vector<std::shared_ptr<const Data>> segments;
+  };
+
+  std::vector<std::shared_ptr<const Data>> buildSegments(
+      const Name &range_name, NodeID nid, uint64_t low, uint64_t high,
+      const Lookup &lookup);
+
+  KeyChain &m_keyChain;
+  const RangeServerOptions m_options;
+  const security::SigningInfo m_signing_info =
+      security::SigningInfo(security::SigningInfo::SIGNER_TYPE_SHA256);
+  // Most recently used first
+  std::list<Stream> m_streams;
+};
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,363 @@
+// Deterministic multi-node SVS simulation in virtual time. Build with
+// `make sim`; run `./svs_sim --help` for the knobs.
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <ndn-cxx/util/dummy-client-face.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+#include <ndn-cxx/util/time-unit-test-clock.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "svs.hpp"
+#include "svs_data_server.hpp"
+#include "svs_data_store.hpp"
+#include "svs_fetcher.hpp"
+
+namespace ndn {
+namespace svs {
+
+struct SimOptions {
+  std::vector<size_t> node_counts = {10, 20, 50, 100, 500, 1000};
+  // Probability that one receiver misses one transmission
+  double loss = 0.0;
+  time::milliseconds delay = time::milliseconds(5);
+  // Nodes are split round-robin into this many groups that cannot hear each
+  // other until partition_duration has passed
+  size_t partitions = 1;
+  time::milliseconds partition_duration = time::milliseconds(0);
+  // Sequence numbers each node publishes at the start
+  uint64_t updates = 1;
+  time::milliseconds time_limit = time::milliseconds(60000);
+  time::milliseconds tick = time::milliseconds(1);
+  uint32_t seed = 1;
+  SyncTimerMode timer_mode = SyncTimerMode::kFixed;
+  SyncMode sync_mode = SyncMode::kFull;
+  // Non-zero also publishes Data for every update and fetches it with a
+  // Fetcher using range interests of up to this many sequence numbers;
+  // convergence then includes holding every other node's data
+  size_t max_range = 0;
+};
+
+struct SimNode {
+  std::unique_ptr<util::DummyClientFace> face;
+  std::unique_ptr<SVS> svs;
+  // Set with SimOptions::max_range only
+  std::unique_ptr<DataStore> store;
+  std::unique_ptr<DataServer> server;
+  std::unique_ptr<Fetcher> fetcher;
+  size_t partition;
+  uint64_t packets_sent = 0;
+  uint64_t bytes_sent = 0;
+  // Data of other nodes held
+  uint64_t fetched = 0;
+};
+
+/**
+ * Simulation - N SVS instances on DummyClientFaces sharing one io_service,
+ *  connected by a broadcast medium with per-receiver loss, fixed delay and
+ *  an optional partition. Interests reach every node in range; Data only
+ *  reaches the nodes whose pending interest it answers, since every other
+ *  receiver would drop it for lack of a PIT entry. With max_range, nodes
+ *  also publish, serve and fetch Data as the client does.
+ */
+class Simulation {
+ public:
+  Simulation(size_t node_count, const SimOptions &options)
+      : m_options(options),
+        m_steady_clock(make_shared<time::UnitTestSteadyClock>()),
+        m_system_clock(make_shared<time::UnitTestSystemClock>()),
+        m_scheduler(m_io),
+        m_keyChain("pib-memory:", "tpm-memory:"),
+        m_rng(options.seed) {
+    time::setCustomClocks(m_steady_clock, m_system_clock);
+
+    for (size_t i = 0; i < node_count; ++i) {
+      SimNode node;
+      node.face.reset(new util::DummyClientFace(
+          m_io, m_keyChain, util::DummyClientFace::Options(false, true)));
+      SVSOptions svs_options;
+      svs_options.random_seed = options.seed * 7919 + i + 1;
+      svs_options.timer_mode = options.timer_mode;
+      svs_options.sync_mode = options.sync_mode;
+      node.svs.reset(new SVS(
+          i,
+          [this, i](const std::vector<MissingDataInfo> &updates) {
+            onSyncUpdate(i, updates);
+          },
+          *node.face, m_keyChain, svs_options));
+      if (options.max_range > 0) {
+        FetcherOptions fetcher_options;
+        fetcher_options.max_range = options.max_range;
+        SVS *svs = node.svs.get();
+        node.store.reset(new DataStore());
+        node.server.reset(new DataServer(*node.svs, *node.face, m_keyChain,
+                                         *node.store));
+        node.fetcher.reset(new Fetcher(
+            *node.face, m_scheduler, fetcher_options,
+            [svs](const Interest &interest, const DataCallback &onData,
+                  const NackCallback &onNack,
+                  const TimeoutCallback &onTimeout) {
+              svs->sendDataInterest(interest, onData, onNack, onTimeout);
+            }));
+      }
+      node.partition = i % std::max<size_t>(options.partitions, 1);
+      m_nodes.push_back(std::move(node));
+    }
+
+    for (size_t i = 0; i < node_count; ++i) {
+      m_nodes[i].face->onSendInterest.connect(
+          [this, i](const Interest &interest) { onSendInterest(i, interest); });
+      m_nodes[i].face->onSendData.connect(
+          [this, i](const Data &data) { onSendData(i, data); });
+    }
+  }
+
+  ~Simulation() { time::setCustomClocks(nullptr, nullptr); }
+
+  /**
+   * run() - Publish, then advance virtual time until every node knows every
+   *  other node's latest sequence number or the time limit passes. Print one
+   *  JSON line with the results.
+   */
+  void run() {
+    for (auto &node : m_nodes) {
+      node.svs->registerPrefix();
+      if (node.server) node.server->registerPrefix();
+      node.svs->start();
+    }
+    advance(time::milliseconds(10));
+
+    for (auto &node : m_nodes) {
+      for (uint64_t i = 0; i < m_options.updates; ++i) {
+        if (node.server) publish(node, i + 1);
+        node.svs->doUpdate();
+      }
+    }
+
+    time::milliseconds elapsed(0);
+    bool converged = false;
+    while (elapsed < m_options.time_limit) {
+      advance(m_options.tick);
+      elapsed += m_options.tick;
+      if (elapsed.count() % 10 == 0 && isConverged()) {
+        converged = true;
+        break;
+      }
+    }
+
+    uint64_t packets = 0, bytes = 0;
+    for (const auto &node : m_nodes) {
+      packets += node.packets_sent;
+      bytes += node.bytes_sent;
+    }
+    printf(
+        "{\"nodes\": %zu, \"loss\": %.3f, \"delay_ms\": %lld, "
+        "\"partitions\": %zu, \"partition_ms\": %lld, \"timer\": \"%s\", "
+        "\"sync\": \"%s\", \"max_range\": %zu, \"converged\": %s, "
+        "\"convergence_ms\": %lld, \"packets_per_node\": %.1f, "
+        "\"bytes_per_node\": %.1f}\n",
+        m_nodes.size(), m_options.loss,
+        static_cast<long long>(m_options.delay.count()), m_options.partitions,
+        static_cast<long long>(m_options.partition_duration.count()),
+        m_options.timer_mode == SyncTimerMode::kTrickle ? "trickle" : "fixed",
+        m_options.sync_mode == SyncMode::kDelta
+            ? "delta"
+            : m_options.sync_mode == SyncMode::kSketch ? "sketch" : "full",
+        m_options.max_range, converged ? "true" : "false", static_cast<long long>(elapsed.count()),
+        static_cast<double>(packets) / m_nodes.size(),
+        static_cast<double>(bytes) / m_nodes.size());
+    fflush(stdout);
+  }
+
+ private:
+  void advance(time::milliseconds duration) {
+    for (time::milliseconds t(0); t < duration; t += m_options.tick) {
+      m_steady_clock->advance(m_options.tick);
+      m_system_clock->advance(m_options.tick);
+      m_io.poll();
+      m_io.reset();
+      m_now += m_options.tick;
+    }
+  }
+
+  bool inRange(size_t from, size_t to) const {
+    if (from == to) return false;
+    if (m_now < m_options.partition_duration)
+      return m_nodes[from].partition == m_nodes[to].partition;
+    return true;
+  }
+
+  bool isLost() {
+    return m_options.loss > 0 &&
+           std::bernoulli_distribution(m_options.loss)(m_rng);
+  }
+
+  void onSendInterest(size_t from, const Interest &interest) {
+    // Prefix registration with the (dummy) local forwarder
+    if (Name("/localhost").isPrefixOf(interest.getName())) return;
+
+    m_nodes[from].packets_sent++;
+    m_nodes[from].bytes_sent += interest.wireEncode().size();
+    auto &requesters = m_pending[interest.getName()];
+    if (std::find(requesters.begin(), requesters.end(), from) ==
+        requesters.end())
+      requesters.push_back(from);
+
+    for (size_t to = 0; to < m_nodes.size(); ++to) {
+      if (!inRange(from, to) || isLost()) continue;
+      m_scheduler.schedule(m_options.delay, [this, to, interest] {
+        m_nodes[to].face->receive(interest);
+      });
+    }
+  }
+
+  void onSendData(size_t from, const Data &data) {
+    m_nodes[from].packets_sent++;
+    m_nodes[from].bytes_sent += data.wireEncode().size();
+
+    auto it = m_pending.find(data.getName());
+    if (it == m_pending.end()) return;
+    // Data consumes the pending interest of every requester it reaches;
+    // range names are requested by many nodes at once
+    auto &requesters = it->second;
+    for (size_t i = 0; i < requesters.size();) {
+      size_t to = requesters[i];
+      if (!inRange(from, to) || isLost()) {
+        ++i;
+        continue;
+      }
+      m_scheduler.schedule(m_options.delay, [this, to, data] {
+        m_nodes[to].face->receive(data);
+      });
+      requesters[i] = requesters.back();
+      requesters.pop_back();
+    }
+    if (requesters.empty()) m_pending.erase(it);
+  }
+
+  /**
+   * publish() - Make the Data of node's update seq servable.
+   */
+  void publish(SimNode &node, uint64_t seq) {
+    auto data = std::make_shared<Data>(MakeDataName(node.svs->getId(), seq));
+    data->setContent(reinterpret_cast<const uint8_t *>(&seq), sizeof(seq));
+    m_keyChain.sign(*data, security::SigningInfo(
+                               security::SigningInfo::SIGNER_TYPE_SHA256));
+    node.server->insert(data, true);
+  }
+
+  void onSyncUpdate(size_t i, const std::vector<MissingDataInfo> &updates) {
+    SimNode &node = m_nodes[i];
+    if (!node.fetcher) return;
+    node.fetcher->fetchUpdates(updates, [this, i](const Data &data) {
+      SimNode &node = m_nodes[i];
+      const Name &n = data.getName();
+      if (node.store->contains(ExtractNodeID(n), ExtractSequence(n))) return;
+      // Range replies arrive split into packets; keep them like the client
+      node.server->insert(data.shared_from_this());
+      ++node.fetched;
+    });
+  }
+
+  bool isConverged() const {
+    for (const auto &node : m_nodes) {
+      if (node.fetcher &&
+          node.fetched != (m_nodes.size() - 1) * m_options.updates)
+        return false;
+      const VersionVector &vv = node.svs->getState();
+      for (size_t i = 0; i < m_nodes.size(); ++i) {
+        if (vv.get(i) != m_options.updates) return false;
+      }
+    }
+    return true;
+  }
+
+  const SimOptions m_options;
+  boost::asio::io_service m_io;
+  shared_ptr<time::UnitTestSteadyClock> m_steady_clock;
+  shared_ptr<time::UnitTestSystemClock> m_system_clock;
+  Scheduler m_scheduler;
+  KeyChain m_keyChain;
+  std::mt19937 m_rng;
+  std::vector<SimNode> m_nodes;
+  // Senders of every interest seen on the medium and not yet answered, by
+  // name
+  std::unordered_map<Name, std::vector<size_t>> m_pending;
+  time::milliseconds m_now = time::milliseconds(0);
+};
+
+}  // namespace svs
+}  // namespace ndn
+
+static void Usage(const char *program) {
+  printf(
+      "Usage: %s [--nodes N[,N...]] [--loss P] [--delay MS] "
+      "[--partitions K] [--partition-ms MS] [--updates U] "
+      "[--time-limit MS] [--seed S] [--timer fixed|trickle] "
+      "[--sync full|delta|sketch] [--range N]\n",
+      program);
+}
+
+int main(int argc, char **argv) {
+  using namespace ndn;
+  svs::SimOptions options;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--help" || i + 1 >= argc) {
+      Usage(argv[0]);
+      return arg == "--help" ? 0 : 1;
+    }
+    std::string value = argv[++i];
+    if (arg == "--nodes") {
+      options.node_counts.clear();
+      size_t start = 0;
+      while (start <= value.size()) {
+        size_t end = value.find(',', start);
+        if (end == std::string::npos) end = value.size();
+        options.node_counts.push_back(
+            std::stoul(value.substr(start, end - start)));
+        start = end + 1;
+      }
+    } else if (arg == "--loss") {
+      options.loss = std::stod(value);
+    } else if (arg == "--delay") {
+      options.delay = time::milliseconds(std::stoll(value));
+    } else if (arg == "--partitions") {
+      options.partitions = std::stoul(value);
+    } else if (arg == "--partition-ms") {
+      options.partition_duration = time::milliseconds(std::stoll(value));
+    } else if (arg == "--updates") {
+      options.updates = std::stoull(value);
+    } else if (arg == "--time-limit") {
+      options.time_limit = time::milliseconds(std::stoll(value));
+    } else if (arg == "--range") {
+      options.max_range = std::stoul(value);
+    } else if (arg == "--seed") {
+      options.seed = std::stoul(value);
+    } else if (arg == "--timer" && (value == "fixed" || value == "trickle")) {
+      options.timer_mode = value == "trickle" ? svs::SyncTimerMode::kTrickle
+                                              : svs::SyncTimerMode::kFixed;
+    } else if (arg == "--sync" &&
+               (value == "full" || value == "delta" || value == "sketch")) {
+      options.sync_mode = value == "delta"    ? svs::SyncMode::kDelta
+                          : value == "sketch" ? svs::SyncMode::kSketch
+                                              : svs::SyncMode::kFull;
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+
+  for (size_t node_count : options.node_counts) {
+    svs::Simulation simulation(node_count, options);
+    simulation.run();
+  }
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include "svs_sketch.hpp"
+
+#include <algorithm>
+
+#include "svs_helper.hpp"
+
+namespace ndn {
+namespace svs {
+
+/**
+ * Mix() - splitmix64 finalizer.
+ */
+static uint64_t Mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+StateSketch::StateSketch(size_t cells) {
+  // Equal sub-tables, at least one cell each
+  size_t sub = std::max<size_t>((cells + kHashes - 1) / kHashes, 1);
+  m_cells.resize(sub * kHashes);
+}
+
+void StateSketch::clear() {
+  for (auto &cell : m_cells) cell = Cell();
+}
+
+size_t StateSketch::cellIndex(NodeID nid, uint64_t seq, size_t i) const {
+  size_t sub = m_cells.size() / kHashes;
+  uint64_t h = Mix(nid * 0x9E3779B97F4A7C15ULL ^ Mix(seq + i + 1));
+  return i * sub + h % sub;
+}
+
+uint32_t StateSketch::checksum(NodeID nid, uint64_t seq) {
+  return static_cast<uint32_t>(Mix(Mix(nid) ^ seq ^ 0xD6E8FEB86659FD93ULL));
+}
+
+void StateSketch::toggle(NodeID nid, uint64_t seq, int64_t sign) {
+  uint32_t hash = checksum(nid, seq);
+  for (size_t i = 0; i < kHashes; ++i) {
+    Cell &cell = m_cells[cellIndex(nid, seq, i)];
+    cell.count += sign;
+    cell.id_sum ^= nid;
+    cell.seq_sum ^= seq;
+    cell.hash_sum ^= hash;
+  }
+}
+
+void StateSketch::subtract(const StateSketch &other) {
+  for (size_t i = 0; i < m_cells.size() && i < other.m_cells.size(); ++i) {
+    m_cells[i].count -= other.m_cells[i].count;
+    m_cells[i].id_sum ^= other.m_cells[i].id_sum;
+    m_cells[i].seq_sum ^= other.m_cells[i].seq_sum;
+    m_cells[i].hash_sum ^= other.m_cells[i].hash_sum;
+  }
+}
+
+bool StateSketch::isPure(const Cell &cell) const {
+  return (cell.count == 1 || cell.count == -1) &&
+         cell.hash_sum == checksum(cell.id_sum, cell.seq_sum);
+}
+
+bool StateSketch::peel(std::vector<std::pair<NodeID, uint64_t>> &mine,
+                       std::vector<std::pair<NodeID, uint64_t>> &theirs) const {
+  StateSketch work = *this;
+  std::vector<size_t> pure;
+  for (size_t i = 0; i < work.m_cells.size(); ++i)
+    if (work.isPure(work.m_cells[i])) pure.push_back(i);
+
+  while (!pure.empty()) {
+    size_t i = pure.back();
+    pure.pop_back();
+    const Cell &cell = work.m_cells[i];
+    // Already peeled through another of its cells
+    if (!work.isPure(cell)) continue;
+
+    // A false positive of the checksum can keep the loop going; a decodable
+    // difference never has more entries than cells
+    if (mine.size() + theirs.size() >= work.m_cells.size()) return false;
+
+    NodeID nid = cell.id_sum;
+    uint64_t seq = cell.seq_sum;
+    int64_t sign = cell.count;
+    (sign > 0 ? mine : theirs).emplace_back(nid, seq);
+    work.toggle(nid, seq, -sign);
+    for (size_t j = 0; j < kHashes; ++j) {
+      size_t k = work.cellIndex(nid, seq, j);
+      if (work.isPure(work.m_cells[k])) pure.push_back(k);
+    }
+  }
+
+  for (const auto &cell : work.m_cells) {
+    if (cell.count != 0 || cell.id_sum != 0 || cell.seq_sum != 0 ||
+        cell.hash_sum != 0)
+      return false;
+  }
+  return true;
+}
+
+std::string StateSketch::encode() const {
+  std::string cells;
+  cells.reserve(m_cells.size() * 12);
+  AppendVarint(cells, m_cells.size());
+  for (const auto &cell : m_cells) {
+    // Zigzag, so small negative counts stay short
+    AppendVarint(cells, (static_cast<uint64_t>(cell.count) << 1) ^
+                            static_cast<uint64_t>(cell.count >> 63));
+    AppendVarint(cells, cell.id_sum);
+    AppendVarint(cells, cell.seq_sum);
+    for (int shift = 24; shift >= 0; shift -= 8)
+      cells.push_back(static_cast<char>((cell.hash_sum >> shift) & 0xFF));
+  }
+
+  std::string out;
+  out.reserve(cells.size() + 4);
+  out.push_back(static_cast<char>(kTlvStateSketch));
+  AppendVarint(out, cells.size());
+  out += cells;
+  return out;
+}
+
+bool StateSketch::decode(const uint8_t *buf, size_t size,
+                         StateSketch &sketch) {
+  const uint8_t *cur = buf;
+  const uint8_t *end = buf + size;
+  uint64_t length, count;
+  if (cur == end || *cur++ != kTlvStateSketch) return false;
+  if (!ReadVarint(cur, end, length) || length != static_cast<uint64_t>(end - cur))
+    return false;
+  // Every cell takes at least 7 bytes
+  if (!ReadVarint(cur, end, count) || count == 0 || count % kHashes != 0 ||
+      count > static_cast<uint64_t>(end - cur) / 7)
+    return false;
+
+  sketch.m_cells.assign(count, Cell());
+  for (auto &cell : sketch.m_cells) {
+    uint64_t zigzag;
+    if (!ReadVarint(cur, end, zigzag) || !ReadVarint(cur, end, cell.id_sum) ||
+        !ReadVarint(cur, end, cell.seq_sum) || end - cur < 4)
+      return false;
+    cell.count = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+    for (int i = 0; i < 4; ++i) cell.hash_sum = (cell.hash_sum << 8) | *cur++;
+  }
+  return cur == end;
+}
+
+}  // namespace svs
+}  // namespace ndn
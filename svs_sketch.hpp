@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "svs_common.hpp"
+
+namespace ndn {
+namespace svs {
+
+// TLV type of a sketch-encoded state vector:
+//  StateSketch = 0xCD <length> <cell count> *Cell
+//  Cell        = <zigzag count> <id sum> <seq sum> <4-byte hash sum>
+// All but the hash sum are varints.
+static const uint8_t kTlvStateSketch = 0xCD;
+
+/**
+ * StateSketch - Invertible Bloom filter over the (NodeID, seq) entries of a
+ *  state vector. Subtracting the sketch of another vector and peeling the
+ *  result recovers the entries in which the two differ, at a cost
+ *  proportional to the number of differences, as long as they fit the cell
+ *  count (roughly two thirds of it). Entries at seq 0 are never inserted.
+ */
+class StateSketch {
+ public:
+  explicit StateSketch(size_t cells);
+
+  void insert(NodeID nid, uint64_t seq) { toggle(nid, seq, 1); }
+
+  void erase(NodeID nid, uint64_t seq) { toggle(nid, seq, -1); }
+
+  /**
+   * update() - Replace entry (nid, old_seq) with (nid, new_seq).
+   */
+  void update(NodeID nid, uint64_t old_seq, uint64_t new_seq) {
+    if (old_seq != 0) erase(nid, old_seq);
+    if (new_seq != 0) insert(nid, new_seq);
+  }
+
+  void clear();
+
+  size_t cells() const { return m_cells.size(); }
+
+  /**
+   * subtract() - Make this the sketch of the difference this - other. Both
+   *  must have the same cell count.
+   */
+  void subtract(const StateSketch &other);
+
+  /**
+   * peel() - Decode a difference sketch into the entries only the minuend
+   *  holds (mine) and only the subtrahend holds (theirs). Return false if
+   *  the differences did not fit; the lists are then incomplete.
+   */
+  bool peel(std::vector<std::pair<NodeID, uint64_t>> &mine,
+            std::vector<std::pair<NodeID, uint64_t>> &theirs) const;
+
+  std::string encode() const;
+
+  /**
+   * decode() - Parse a StateSketch TLV. Return false if it is malformed.
+   */
+  static bool decode(const uint8_t *buf, size_t size, StateSketch &sketch);
+
+ private:
+  struct Cell {
+    int64_t count = 0;
+    uint64_t id_sum = 0;
+    uint64_t seq_sum = 0;
+    uint32_t hash_sum = 0;
+  };
+
+  static const size_t kHashes = 3;
+
+  void toggle(NodeID nid, uint64_t seq, int64_t sign);
+
+  // Cell of the entry in sub-table i; every entry maps to one cell in each
+  // of the kHashes equal sub-tables
+  size_t cellIndex(NodeID nid, uint64_t seq, size_t i) const;
+
+  static uint32_t checksum(NodeID nid, uint64_t seq);
+
+  bool isPure(const Cell &cell) const;
+
+  std::vector<Cell> m_cells;
+};
+
+inline bool IsSketchVV(const uint8_t *buf, size_t size) {
+  return size > 0 && buf[0] == kTlvStateSketch;
+}
+
+}  // namespace svs
+}  // namespace ndn
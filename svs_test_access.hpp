@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <utility>
+
+#include "svs.hpp"
+
+namespace ndn {
+namespace svs {
+
+/**
+ * SVSTestAccess - Reaches SVS internals for benchmarks and tests, so they
+ *  can drive the hot paths in isolation. Call on the event loop thread of
+ *  an SVS that has start()ed; not for applications.
+ */
+struct SVSTestAccess {
+  static VersionVector &state(SVS &svs) { return svs.m_vv; }
+
+  // Invalidate the encoded vector, as a change of state would
+  static void touchState(SVS &svs) { ++svs.m_vv_generation; }
+
+  static std::pair<bool, bool> mergeStateVector(SVS &svs,
+                                                const VersionVector &other) {
+    return svs.mergeStateVector(other);
+  }
+
+  static const std::string &getEncodedVV(SVS &svs) {
+    return svs.getEncodedVV();
+  }
+
+  static void queueSyncInterest(SVS &svs, const Name &n) {
+    svs.queueSyncInterest(n);
+  }
+
+  static void sendSyncACK(SVS &svs, const Name &n) { svs.sendSyncACK(n); }
+
+  static TxScheduler &txQueue(SVS &svs) { return svs.m_tx_queue; }
+};
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <ndn-cxx/util/time.hpp>
+
+namespace ndn {
+namespace svs {
+
+/**
+ * TokenBucket - Paces transmissions to rate packets per second on average,
+ *  allowing bursts of up to burst packets after an idle period.
+ */
+class TokenBucket {
+ public:
+  TokenBucket(double rate, double burst)
+      : m_rate(rate),
+        m_burst(std::max(burst, 1.0)),
+        m_tokens(m_burst),
+        m_last(time::steady_clock::now()) {}
+
+  /**
+   * consume() - Take one token if available. Return false otherwise.
+   */
+  bool consume() {
+    refill();
+    if (m_tokens < 1) return false;
+    m_tokens -= 1;
+    return true;
+  }
+
+  /**
+   * timeUntilAvailable() - Time until consume() can succeed; zero if it can
+   *  now.
+   */
+  time::nanoseconds timeUntilAvailable() {
+    refill();
+    if (m_tokens >= 1 || m_rate <= 0) return time::nanoseconds(0);
+    return time::nanoseconds(
+        static_cast<int64_t>((1 - m_tokens) / m_rate * 1e9) + 1);
+  }
+
+ private:
+  void refill() {
+    auto now = time::steady_clock::now();
+    if (m_rate <= 0) {
+      // Unpaced
+      m_tokens = m_burst;
+    } else {
+      double elapsed =
+          time::duration_cast<time::nanoseconds>(now - m_last).count() / 1e9;
+      m_tokens = std::min(m_burst, m_tokens + elapsed * m_rate);
+    }
+    m_last = now;
+  }
+
+  const double m_rate;
+  const double m_burst;
+  double m_tokens;
+  time::steady_clock::TimePoint m_last;
+};
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <ndn-cxx/util/time.hpp>
+#include <random>
+
+namespace ndn {
+namespace svs {
+
+/**
+ * TrickleTimer - Interval state of the Trickle algorithm (RFC 6206). The
+ *  owner schedules the events: beginInterval() returns when to consider
+ *  transmitting, shouldTransmit() decides at that point, and the interval
+ *  ends remaining() later with doubleInterval() and a new beginInterval().
+ */
+class TrickleTimer {
+ public:
+  TrickleTimer(time::milliseconds interval_min, time::milliseconds interval_max,
+               uint32_t redundancy)
+      : m_interval_min(std::max(interval_min, time::milliseconds(1))),
+        m_interval_max(std::max(interval_max, m_interval_min)),
+        m_redundancy(redundancy),
+        m_interval(m_interval_min) {}
+
+  /**
+   * beginInterval() - Clear the consistency counter and pick the
+   *  transmission point uniformly in [I/2, I). Return its offset from now.
+   */
+  template <typename Rng>
+  time::milliseconds beginInterval(Rng &rng) {
+    m_counter = 0;
+    auto half = m_interval.count() / 2;
+    std::uniform_int_distribution<int64_t> dist(half, m_interval.count() - 1);
+    m_transmit_point = time::milliseconds(std::max<int64_t>(dist(rng), half));
+    return m_transmit_point;
+  }
+
+  /**
+   * remaining() - Time from the transmission point to the end of the
+   *  interval.
+   */
+  time::milliseconds remaining() const { return m_interval - m_transmit_point; }
+
+  void hearConsistent() { ++m_counter; }
+
+  /**
+   * shouldTransmit() - Whether fewer than k consistent transmissions were
+   *  heard this interval. k of zero never suppresses.
+   */
+  bool shouldTransmit() const {
+    return m_redundancy == 0 || m_counter < m_redundancy;
+  }
+
+  void doubleInterval() { m_interval = std::min(m_interval * 2, m_interval_max); }
+
+  /**
+   * reset() - Shrink the interval to the minimum on an inconsistency. Return
+   *  false if it already was, in which case the current interval goes on.
+   */
+  bool reset() {
+    if (m_interval <= m_interval_min) return false;
+    m_interval = m_interval_min;
+    return true;
+  }
+
+  time::milliseconds getInterval() const { return m_interval; }
+
+ private:
+  const time::milliseconds m_interval_min;
+  const time::milliseconds m_interval_max;
+  const uint32_t m_redundancy;
+  time::milliseconds m_interval;
+  time::milliseconds m_transmit_point = time::milliseconds(0);
+  uint32_t m_counter = 0;
+};
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,104 @@
+#include "svs_tx_scheduler.hpp"
+
+namespace ndn {
+namespace svs {
+
+/**
+ * PacketSize() - Encoded size of the packet, the unit quanta are counted in.
+ */
+static size_t PacketSize(const Packet &packet) {
+  if (packet.packet_type == Packet::INTEREST_TYPE)
+    return packet.interest.wireEncode().size();
+  return packet.getData().wireEncode().size();
+}
+
+TxScheduler::TxScheduler(
+    const std::array<TxClassConfig, kTxClassCount> &config) {
+  for (size_t i = 0; i < kTxClassCount; ++i) {
+    m_classes[i].config = config[i];
+    if (m_classes[i].config.quantum == 0) m_classes[i].config.quantum = 1;
+  }
+}
+
+bool TxScheduler::enqueue(TxClass tx_class, PacketPtr packet) {
+  ClassState &state = m_classes[tx_class];
+
+  if (state.config.drop_policy == DropPolicy::kKeepNewest) {
+    while (!state.queue.empty()) drop(state, state.queue.pop_front());
+  } else if (state.queue.size() >= state.config.max_packets) {
+    if (state.config.drop_policy == DropPolicy::kDropTail ||
+        state.queue.empty()) {
+      drop(state, std::move(packet));
+      return false;
+    }
+    drop(state, state.queue.pop_front());
+  }
+
+  state.queue.push_back(std::move(packet));
+  return true;
+}
+
+PacketPtr TxScheduler::dequeue() {
+  auto now = time::steady_clock::now();
+
+  // Every pass either sends, empties a class or grows a deficit by a
+  // non-zero quantum, so the loop terminates.
+  while (!empty()) {
+    ClassState &state = m_classes[m_current];
+    dropExpired(state, now);
+    if (state.queue.empty()) {
+      state.deficit = 0;
+      nextClass();
+      continue;
+    }
+
+    if (!m_credited) {
+      state.deficit += state.config.quantum;
+      m_credited = true;
+    }
+
+    int64_t size = PacketSize(state.queue.front());
+    if (size > state.deficit) {
+      nextClass();
+      continue;
+    }
+
+    PacketPtr packet = state.queue.pop_front();
+    state.deficit -= size;
+    if (state.queue.empty()) {
+      state.deficit = 0;
+      nextClass();
+    }
+    return packet;
+  }
+  return nullptr;
+}
+
+bool TxScheduler::empty() const {
+  for (const auto &state : m_classes) {
+    if (!state.queue.empty()) return false;
+  }
+  return true;
+}
+
+void TxScheduler::drop(ClassState &state, PacketPtr packet) {
+  ++state.dropped;
+  m_dropped.push_back(std::move(packet));
+}
+
+void TxScheduler::dropExpired(ClassState &state,
+                              time::steady_clock::TimePoint now) {
+  if (state.config.deadline <= time::milliseconds(0)) return;
+  while (!state.queue.empty() &&
+         now - state.queue.front().enqueue_time > state.config.deadline) {
+    drop(state, state.queue.pop_front());
+  }
+}
+
+void TxScheduler::nextClass() {
+  m_current = (m_current + 1) % kTxClassCount;
+  m_credited = false;
+}
+
+}  // namespace svs
+}  // namespace ndn
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+
+#include "svs_common.hpp"
+#include "svs_packet_pool.hpp"
+
+namespace ndn {
+namespace svs {
+
+/**
+ * TxScheduler - Multi-class transmit queue. Classes are served by deficit
+ *  round robin weighted by their byte quantum, so no class can starve
+ *  another on the shared broadcast medium. Each class has its own queue
+ *  limit, drop policy and deadline. Not thread-safe.
+ */
+class TxScheduler {
+ public:
+  explicit TxScheduler(const std::array<TxClassConfig, kTxClassCount> &config);
+
+  /**
+   * enqueue() - Add packet to the queue of its class, applying the class drop
+   *  policy if the queue is full. Return false if packet itself was dropped.
+   *  Dropped packets wait in takeDropped().
+   */
+  bool enqueue(TxClass tx_class, PacketPtr packet);
+
+  /**
+   * dequeue() - Return the next packet to send, or nullptr if every queue is
+   *  empty. Packets past their class deadline are dropped on the way.
+   */
+  PacketPtr dequeue();
+
+  bool empty() const;
+
+  /**
+   * takeDropped() - Return the oldest packet dropped and not yet taken, or
+   *  nullptr. Owners fail their callbacks from outside the scheduler, which
+   *  may safely enqueue again.
+   */
+  PacketPtr takeDropped() {
+    return m_dropped.empty() ? nullptr : m_dropped.pop_front();
+  }
+
+  size_t size(TxClass tx_class) const {
+    return m_classes[tx_class].queue.size();
+  }
+
+  // Packets dropped from tx_class by its drop policy or deadline
+  uint64_t getDropped(TxClass tx_class) const {
+    return m_classes[tx_class].dropped;
+  }
+
+ private:
+  struct ClassState {
+    TxClassConfig config;
+    PacketQueue queue;
+    int64_t deficit = 0;
+    uint64_t dropped = 0;
+  };
+
+  void drop(ClassState &state, PacketPtr packet);
+
+  void dropExpired(ClassState &state, time::steady_clock::TimePoint now);
+
+  void nextClass();
+
+  std::array<ClassState, kTxClassCount> m_classes;
+  PacketQueue m_dropped;
+  size_t m_current = 0;
+  // Whether m_current has received its quantum for this round
+  bool m_credited = false;
+};
+
+}  // namespace svs
+}  // namespace ndn
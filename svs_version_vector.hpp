@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "svs_common.hpp"
+
+namespace ndn {
+namespace svs {
+
+/**
+ * VersionVector - State vector stored as two parallel arrays (NodeIDs and
+ *  sequence numbers) sorted by NodeID. Lookups are binary searches and
+ *  merging two vectors is a single linear merge-join. Offers the subset of
+ *  the std::unordered_map interface that the sync code relies on; iterators
+ *  yield std::pair<NodeID, uint64_t> by value.
+ */
+class VersionVector {
+ public:
+  using value_type = std::pair<NodeID, uint64_t>;
+
+  class const_iterator {
+   public:
+    struct ArrowProxy {
+      value_type entry;
+      const value_type *operator->() const { return &entry; }
+    };
+
+    const_iterator(const VersionVector *vv, size_t i) : vv_(vv), i_(i) {}
+
+    value_type operator*() const {
+      return value_type(vv_->m_ids[i_], vv_->m_seqs[i_]);
+    }
+    ArrowProxy operator->() const { return ArrowProxy{**this}; }
+    const_iterator &operator++() {
+      ++i_;
+      return *this;
+    }
+    bool operator==(const const_iterator &o) const { return i_ == o.i_; }
+    bool operator!=(const const_iterator &o) const { return i_ != o.i_; }
+
+   private:
+    const VersionVector *vv_;
+    size_t i_;
+  };
+  using iterator = const_iterator;
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, m_ids.size()); }
+
+  size_t size() const { return m_ids.size(); }
+  bool empty() const { return m_ids.empty(); }
+
+  void clear() {
+    m_ids.clear();
+    m_seqs.clear();
+  }
+
+  void reserve(size_t n) {
+    m_ids.reserve(n);
+    m_seqs.reserve(n);
+  }
+
+  const_iterator find(NodeID nid) const {
+    size_t i = lowerBound(nid);
+    if (i < m_ids.size() && m_ids[i] == nid) return const_iterator(this, i);
+    return end();
+  }
+
+  size_t count(NodeID nid) const { return find(nid) != end() ? 1 : 0; }
+
+  /**
+   * get() - Return seq of nid, or 0 if nid is not in the vector.
+   */
+  uint64_t get(NodeID nid) const {
+    size_t i = lowerBound(nid);
+    return (i < m_ids.size() && m_ids[i] == nid) ? m_seqs[i] : 0;
+  }
+
+  /**
+   * operator[]() - Return reference to seq of nid, inserting 0 if absent.
+   *  Appending in ascending NodeID order (as decoders do) is O(1).
+   */
+  uint64_t &operator[](NodeID nid) {
+    if (m_ids.empty() || m_ids.back() < nid) {
+      m_ids.push_back(nid);
+      m_seqs.push_back(0);
+      return m_seqs.back();
+    }
+    size_t i = lowerBound(nid);
+    if (m_ids[i] != nid) {
+      m_ids.insert(m_ids.begin() + i, nid);
+      m_seqs.insert(m_seqs.begin() + i, 0);
+    }
+    return m_seqs[i];
+  }
+
+  bool operator==(const VersionVector &o) const {
+    return m_ids == o.m_ids && m_seqs == o.m_seqs;
+  }
+  bool operator!=(const VersionVector &o) const { return !(*this == o); }
+
+  const std::vector<NodeID> &ids() const { return m_ids; }
+  const std::vector<uint64_t> &seqs() const { return m_seqs; }
+
+  /**
+   * merge() - Merge other into this vector in one linear pass. Append the
+   *  sequence ranges this vector was missing to missing, and return a pair of
+   *  booleans representing: <my_vector_new, other_vector_new>. An entry that
+   *  only one side knows counts as newer on that side, even at seq 0.
+   */
+  std::pair<bool, bool> merge(const VersionVector &other,
+                              std::vector<MissingDataInfo> &missing) {
+    bool my_vector_new = false, other_vector_new = false;
+    std::vector<value_type> added;
+
+    const NodeID *ids = m_ids.data();
+    const NodeID *other_ids = other.m_ids.data();
+    const uint64_t *other_seqs = other.m_seqs.data();
+    uint64_t *seqs = m_seqs.data();
+    size_t i = 0, j = 0, n = m_ids.size(), m = other.m_ids.size();
+
+    while (i < n && j < m) {
+      // Skip identical runs a block at a time; this is the common case once
+      // the group has converged.
+      while (i + kBlock <= n && j + kBlock <= m &&
+             BlockEqual(ids + i, other_ids + j) &&
+             BlockEqual(seqs + i, other_seqs + j)) {
+        i += kBlock;
+        j += kBlock;
+      }
+      if (i >= n || j >= m) break;
+
+      if (ids[i] == other_ids[j]) {
+        if (seqs[i] < other_seqs[j]) {
+          other_vector_new = true;
+          missing.push_back(
+              MissingDataInfo{ids[i], seqs[i] + 1, other_seqs[j]});
+          seqs[i] = other_seqs[j];
+        } else if (seqs[i] > other_seqs[j]) {
+          my_vector_new = true;
+        }
+        ++i;
+        ++j;
+      } else if (ids[i] < other_ids[j]) {
+        my_vector_new = true;
+        ++i;
+      } else {
+        other_vector_new = true;
+        added.emplace_back(other_ids[j], other_seqs[j]);
+        ++j;
+      }
+    }
+    if (i < n) my_vector_new = true;
+    for (; j < m; ++j) {
+      other_vector_new = true;
+      added.emplace_back(other_ids[j], other.m_seqs[j]);
+    }
+
+    if (!added.empty()) {
+      for (const auto &entry : added) {
+        if (entry.second > 0)
+          missing.push_back(MissingDataInfo{entry.first, 1, entry.second});
+      }
+      insertSorted(added);
+    }
+    return std::make_pair(my_vector_new, other_vector_new);
+  }
+
+ private:
+  size_t lowerBound(NodeID nid) const {
+    return std::lower_bound(m_ids.begin(), m_ids.end(), nid) - m_ids.begin();
+  }
+
+  /**
+   * insertSorted() - Merge entries (sorted, none already present) into the
+   *  vector, back to front so no temporary arrays are needed.
+   */
+  void insertSorted(const std::vector<value_type> &entries) {
+    size_t old_size = m_ids.size();
+    m_ids.resize(old_size + entries.size());
+    m_seqs.resize(old_size + entries.size());
+    size_t i = old_size, k = entries.size(), out = m_ids.size();
+    while (k > 0) {
+      if (i > 0 && m_ids[i - 1] > entries[k - 1].first) {
+        --i;
+        --out;
+        m_ids[out] = m_ids[i];
+        m_seqs[out] = m_seqs[i];
+      } else {
+        --k;
+        --out;
+        m_ids[out] = entries[k].first;
+        m_seqs[out] = entries[k].second;
+      }
+    }
+  }
+
+#if defined(__AVX2__)
+  static const size_t kBlock = 4;
+  static bool BlockEqual(const uint64_t *a, const uint64_t *b) {
+    __m256i eq = _mm256_cmpeq_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b)));
+    return _mm256_movemask_epi8(eq) == -1;
+  }
+#elif defined(__SSE2__)
+  static const size_t kBlock = 2;
+  static bool BlockEqual(const uint64_t *a, const uint64_t *b) {
+    // 64-bit lanes are equal iff both of their 32-bit halves are
+    __m128i eq = _mm_cmpeq_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(a)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b)));
+    return _mm_movemask_epi8(eq) == 0xFFFF;
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  static const size_t kBlock = 2;
+  static bool BlockEqual(const uint64_t *a, const uint64_t *b) {
+    uint64x2_t eq = vceqq_u64(vld1q_u64(a), vld1q_u64(b));
+    return (vgetq_lane_u64(eq, 0) & vgetq_lane_u64(eq, 1)) == ~0ULL;
+  }
+#else
+  static const size_t kBlock = 2;
+  static bool BlockEqual(const uint64_t *a, const uint64_t *b) {
+    return a[0] == b[0] && a[1] == b[1];
+  }
+#endif
+
+  std::vector<NodeID> m_ids;
+  std::vector<uint64_t> m_seqs;
+};
+
+}  // namespace svs
+}  // namespace ndn